@@ -0,0 +1,165 @@
+#ifndef _ANALYZER_H
+#define _ANALYZER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "fft.h"
+#include "ringbuffer.h"
+#include "scopehistory.h"
+#include "triplebuffer.h"
+
+// how often the analysis-thread looks for new frames, about display-rate
+#define ANALYZER_PERIOD_MS 8
+// the window advances by a quarter of its size, i.e. 75% overlap
+#define ANALYZER_HOPS 4
+// frames kept in the ring, in multiples of the FFT-size
+#define ANALYZER_HISTORY 16
+// fall-off of the displayed magnitudes per analysed window
+#define ANALYZER_DECAY .85f
+// range of the spectrum-display, spread logarithmically over its bins
+#define ANALYZER_FROM_FREQUENCY 20.f
+#define ANALYZER_TO_FREQUENCY 20'000.f
+// how far back the scope can show, and at most how many columns
+#define ANALYZER_SCOPE_SECONDS 8
+#define ANALYZER_SCOPE_COLUMNS 4096
+// how many frames back the scope looks for a zero-crossing to trigger on
+#define ANALYZER_TRIGGER_SEARCH 4096
+// analysed windows waiting for the UI-thread to take them as spectrogram-rows
+#define ANALYZER_ROWS 64
+
+enum SpectrumWindow {
+    WindowRectangular = 0,
+    WindowHann,
+    WindowBlackmanHarris,
+    SPECTRUM_WINDOWS
+};
+
+extern const char* spectrumWindowNames[];
+
+// which FFT-bins a bin of the display is made of. A single one means that
+// the display is finer than the FFT there, it then interpolates between
+// first and first + 1.
+struct SpectrumBin
+{
+    uint32_t first;
+    uint32_t last;
+    float fraction;
+};
+
+// Everything computeFastFourierTransform needs for one FFT-size and
+// frequency-range, computed once: the real-input FFT, a table for each
+// window and the map from FFT-bins to logarithmically spaced display-bins.
+class SpectrumPlan
+{
+    public:
+        SpectrumPlan (size_t size,
+                      float fromFrequency,
+                      float toFrequency,
+                      size_t frequencyBins,
+                      float sampleRate);
+
+        size_t size () const;
+        void setWindow (SpectrumWindow window);
+
+    private:
+        friend void computeFastFourierTransform (SpectrumPlan& plan,
+                                                 std::vector<float>& sampleBuffer,
+                                                 std::vector<float>& fftBuffer,
+                                                 size_t channels);
+
+        RealFftPlan _fft;
+        SpectrumWindow _window = WindowHann;
+        // SPECTRUM_WINDOWS tables of size() values one after another
+        std::vector<float> _windows;
+        float _scales[SPECTRUM_WINDOWS];
+        std::vector<SpectrumBin> _bins;
+        std::vector<float> _magnitudes;
+};
+
+// Takes everything that is visualised off the audio-thread. The
+// audio-thread only copies each finished block into a ring of frames, a
+// thread of its own moves them on into its history, keeps seconds of the
+// first channel for the scope and computes the spectrum with overlapping
+// windows whenever the display is showing it. Both go to the UI-thread as
+// whole snapshots.
+class Analyzer
+{
+    public:
+        Analyzer (size_t size,
+                  size_t channels,
+                  size_t frequencyBins,
+                  size_t blockFrames,
+                  float sampleRate);
+        ~Analyzer ();
+
+        // starts the analysis-thread
+        void start ();
+
+        // called by the audio-thread, a single copy into the ring. It never
+        // waits, a block that does not fit because the analysis-thread is
+        // that far behind is dropped.
+        void publish (const float* samples, size_t frames);
+
+        // called by the UI-thread
+        void setSpectrum (bool enabled);
+        void setWindow (SpectrumWindow window);
+        // the scope shows span frames in columns, each as its minimum and
+        // maximum, ending at a rising zero-crossing if triggered
+        void setScope (size_t columns, size_t span, bool trigger);
+        size_t scopeHistory () const;
+        // the latest snapshots, valid until the next call. The scope holds
+        // minimum and maximum of each column one after another.
+        const std::vector<float>& scope ();
+        const std::vector<float>& spectrum ();
+        // the magnitudes of the next window analysed, without the peaks
+        // held, one call per window and oldest first. False if there is none.
+        bool spectrogramRow (std::vector<float>& row);
+
+    private:
+        void run ();
+        uint64_t drain ();
+        void takeScope (uint64_t written);
+        bool copyFrames (uint64_t end, std::vector<float>& out) const;
+        void analyze (uint64_t end);
+
+    private:
+        size_t _size;
+        size_t _channels;
+        size_t _capacity;
+        std::vector<float> _ring;
+        alignas(64) std::atomic<uint64_t> _written {0};
+        alignas(64) std::atomic<uint64_t> _read {0};
+
+        std::thread _thread;
+        std::atomic<bool> _running {false};
+        std::atomic<bool> _spectrumEnabled {false};
+        std::atomic<int> _spectrumWindow {WindowHann};
+        std::atomic<size_t> _scopeColumns;
+        std::atomic<size_t> _scopeSpan;
+        std::atomic<bool> _scopeTrigger {true};
+        // the ring's frames at the same positions, owned by the thread
+        std::vector<float> _history;
+        ScopeHistory _scopeHistory;
+        uint64_t _analyzed = 0;
+        SpectrumPlan _plan;
+        std::vector<float> _window;
+        std::vector<float> _frame;
+        std::vector<float> _spectrum;
+
+        TripleBuffer<std::vector<float>> _scopes;
+        TripleBuffer<std::vector<float>> _spectra;
+        RingBuffer<std::vector<float>> _rows;
+};
+
+// windowed magnitudes of the first channel of the interleaved sampleBuffer,
+// one per display-bin at the even indices of fftBuffer
+void computeFastFourierTransform (SpectrumPlan& plan,
+                                  std::vector<float>& sampleBuffer,
+                                  std::vector<float>& fftBuffer,
+                                  size_t channels);
+
+#endif // _ANALYZER_H
@@ -3,138 +3,29 @@
 
 #include <SDL.h>
 
-#include <list>
+#include <atomic>
 #include <map>
 #include <memory>
-#include <queue>
 #include <thread>
 #include <vector>
 
 #include "opengl.h"
 #include "midi.h"
 #include "filters.h"
+#include "ringbuffer.h"
+#include "smf.h"
+#include "synth.h"
 
 using std::vector;
 using std::map;
-using std::queue;
 using std::shared_ptr;
-using std::list;
 using std::thread;
 
-using NoteId = int;
-
-struct Envelope
-{
-    float attackLevel = 1.f;
-    float attackTime = .15f;
-    float decayTime = .2f;
-    float sustainLevel = .8f;
-    float releaseTime = .65f;
-    float noteOnTime = .0f;
-    float noteOffTime = .0f;
-    bool noteActive = false;
-    bool noteReleased = false;
-
-    void noteOn (float currentTime)
-    {
-        noteOnTime = currentTime;
-    }
-
-    void noteOff (float currentTime)
-    {
-        noteOffTime = currentTime;
-    }
-
-    float level (float currentTime)
-    {
-        float outputLevel = .0;
-
-        // handle attack, decay & sustain
-        if (noteOnTime > noteOffTime) {
-            float noteLifetime = currentTime - noteOnTime;
-
-            // attack
-            if (noteLifetime <= attackTime) {
-                outputLevel = (noteLifetime / attackTime) * attackLevel;
-            }
-
-            // decay
-            if (noteLifetime > attackTime &&
-                noteLifetime <= attackTime + decayTime) {
-                float attackSustainLevelDiff = attackLevel - sustainLevel;
-                outputLevel = (1.f - (noteLifetime - attackTime) / decayTime) * attackSustainLevelDiff + sustainLevel;
-            }
-
-            // sustain
-            if (noteLifetime > attackTime + decayTime) {
-                outputLevel = sustainLevel;
-            }
-        } else if (noteOnTime <= noteOffTime) {
-            // handle release
-            noteReleased = true;
-            float releaseLifetime = currentTime - noteOffTime;
-            outputLevel = (1.f - (releaseLifetime / releaseTime)) * sustainLevel;
-        }
-
-        // switch off check
-        if (outputLevel < .0001f) {
-            outputLevel = .0f;
-            noteActive = false;
-        } else {
-            noteActive = true;
-        }
-
-        return outputLevel;
-    }
-};
-
-struct Note
-{
-    NoteId noteId;
-    int voice;
-    Envelope amplitudeADSR;
-    Envelope filterADSR;
-    float velocity = 1.f;
-};
-
-using Notes = list<Note>;
-
-class Synth
-{
-    public:
-        explicit Synth(unsigned int maxVoices = 16);
-
-        void addNote(NoteId note);
-        void removeNote(NoteId note);
-
-        void addNoteMidi(NoteId noteId, float velocity, float timeStamp);
-        void removeNoteMidi(NoteId noteId, float velocity, float timeStamp);
-
-        shared_ptr<Notes> notes();
-        void clearNotes ();
-        int allocVoice();
-        void freeVoice(int voice);
-
-    private:
-        shared_ptr<Notes> _notes;
-        unsigned int _maxVoices;
-        vector<bool> _voiceAllocation;
-};
-
-struct SynthData
-{
-    float sampleRate;
-    size_t channels;
-    size_t samples;
-    size_t frequencyBins;
-    bool doFFT;
-    int ticks;
-    float volume;
-    shared_ptr<Notes> notes;
-    shared_ptr<vector<float>> sampleBufferForDrawing;
-    shared_ptr<vector<float>> fftBufferForDrawing;
-    shared_ptr<vector<vector<float>>> voiceBuffers;
-};
+#define MIDI_EVENT_CAPACITY 512
+// how far ahead of time the file-player hands notes to the synth
+#define SMF_LOOKAHEAD .1
+// frames the scope shows when zoomed in all the way
+#define SCOPE_MIN_SPAN 64
 
 struct MidiMessage
 {
@@ -149,7 +40,8 @@ class Application
     public:
         Application (size_t width,
                      size_t height,
-                     const std::string& midiPort = "hw:1,0,0");
+                     const std::string& midiPort = "hw:1,0,0",
+                     const std::string& smfFile = "");
         ~Application ();
 
         void run ();
@@ -158,9 +50,19 @@ class Application
     private:
         void initialize ();
         void handle_events ();
+        void scheduleNote (MessageType type,
+                           NoteId noteId,
+                           float velocity,
+                           double timeStamp);
+        void sendCommand (CommandType type, float value);
+        void pushCommand (const SynthCommand& command);
+        void flushCommands ();
         static void readMidiKeys (const Midi& midi,
-                                  queue<MessageData>& queue);
+                                  RingBuffer<MidiEvent>& midiEvents);
         static void disco (const Midi& midi);
+        static void playSmf (Smf& smf,
+                             RingBuffer<MidiEvent>& smfEvents,
+                             std::atomic<bool>& playing);
 
     private:
         bool _initialized = false;
@@ -175,15 +77,32 @@ class Application
         int _frequencyBins = 512;
         unsigned int _maxVoices = 16;
         Synth _synth;
-        shared_ptr<Notes> _notes;
         SynthData _synthData;
         map<SDL_Keycode, bool> _pressedKeys;
-        vector<float> _sampleBufferForDrawing;
-        vector<float> _fftBufferForDrawing;
         shared_ptr<OpenGL> _gl;
         Midi _midi;
-        queue<MessageData> _midiMessageQueue;
-        vector<vector<float>> _voiceBuffers;
+        RingBuffer<MidiEvent> _midiEvents {MIDI_EVENT_CAPACITY};
+        // a ring of its own, each ring has exactly one producing thread
+        RingBuffer<MidiEvent> _smfEvents {MIDI_EVENT_CAPACITY};
+        Smf _smf;
+        std::thread _smfPlayer;
+        std::atomic<bool> _playing {false};
+        RingBuffer<SynthCommand> _commands {COMMAND_CAPACITY};
+        // what did not fit into the ring yet, sent in order once it does
+        vector<SynthCommand> _unsentCommands;
+        unsigned long _delayedCommands = 0;
+        // the UI's own copy of what it last sent to the audio-thread
+        int _displayMode = ScopeDisplay;
+        bool _makeDirty = false;
+        float _volume = .1f;
+        int _fmAlgorithm = FmPatch ().algorithm;
+        int _stealPolicy = StealReleaseFirst;
+        int _spectrumWindow = WindowHann;
+        size_t _scopeColumns = 0;
+        size_t _scopeSpan = 1024;
+        bool _scopeTrigger = true;
+        // taken from the analyzer, sized once so that does not allocate
+        vector<float> _spectrogramRow;
 };
 
 #endif // _APPLICATION_H
@@ -0,0 +1,89 @@
+#ifndef _DSPMONITOR_H
+#define _DSPMONITOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// the report of the monitor goes to this file on exit instead of stdout
+#define DSP_REPORT_VARIABLE "SYNTH_DSP_REPORT"
+
+// buckets of 1% of the deadline each, the last one collects everything above
+#define DSP_HISTOGRAM_BUCKETS 201
+
+// a block starting this much later than the previous one's deadline means
+// the device ran dry in between
+#define DSP_XRUN_FACTOR 1.5
+
+struct DspSnapshot
+{
+    uint64_t blocks = 0;
+    uint64_t misses = 0;
+    uint64_t xruns = 0;
+    float deadlineMilliseconds = .0f;
+    // render-time of a block in percent of its deadline
+    float load = .0f;
+    float averageLoad = .0f;
+    float maxLoad = .0f;
+    float p50 = .0f;
+    float p90 = .0f;
+    float p99 = .0f;
+    float p999 = .0f;
+    // average over all blocks a voice was rendered in
+    float averageVoiceMicroseconds = .0f;
+    // of each voice in the last block it was rendered in
+    std::vector<float> voiceMicroseconds;
+};
+
+// Always-on timing of the rendering of blocks. The audio-thread only stores
+// into relaxed atomics, any other thread may take a snapshot at any time,
+// which computes the percentiles from the histogram.
+class DspMonitor
+{
+    public:
+        explicit DspMonitor (size_t voices);
+
+        // called by the audio-thread around rendering a block
+        void beginBlock ();
+        void endBlock (double deadlineSeconds);
+
+        // called by any thread before the audio-device resumes after being
+        // paused, so the gap to the next block is not taken for an xrun
+        void resume ();
+
+        // called by the job rendering a voice, any number of times a block
+        void addVoiceTime (int voice, float microseconds);
+
+        DspSnapshot snapshot () const;
+        void dump (std::ostream& out) const;
+
+        // dumps to the file named by DSP_REPORT_VARIABLE, if set, else to
+        // stdout
+        void report () const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        Clock::time_point _blockStart;
+        Clock::time_point _previousStart;
+        double _previousDeadline = .0;
+        std::atomic<bool> _resumed {false};
+        // written by the jobs of one block, published by endBlock()
+        std::vector<float> _voiceBlock;
+
+        std::atomic<uint64_t> _blocks {0};
+        std::atomic<uint64_t> _misses {0};
+        std::atomic<uint64_t> _xruns {0};
+        std::atomic<float> _deadlineMilliseconds {.0f};
+        std::atomic<float> _load {.0f};
+        std::atomic<float> _maxLoad {.0f};
+        std::atomic<double> _loadSum {.0};
+        std::atomic<uint32_t> _histogram[DSP_HISTOGRAM_BUCKETS];
+        std::atomic<double> _voiceMicrosecondsSum {.0};
+        std::atomic<uint64_t> _voiceBlocks {0};
+        std::vector<std::atomic<float>> _voiceMicroseconds;
+};
+
+#endif // _DSPMONITOR_H
@@ -0,0 +1,52 @@
+#ifndef _ENVELOPE_H
+#define _ENVELOPE_H
+
+#include <cstddef>
+
+// ADSR-envelope advancing by samples instead of looking at the clock. Each
+// segment is a recurrence level = level*multiplier + increment, which is a
+// linear ramp for a multiplier of 1 and an exponential approach towards the
+// segment's end-level otherwise. Both values and the length of a segment in
+// samples are computed once when the segment is entered.
+struct Envelope
+{
+    enum Stage { Idle = 0, Attack, Decay, Sustain, Release };
+
+    float attackLevel = 1.f;
+    float attackTime = .15f;
+    float decayTime = .2f;
+    float sustainLevel = .8f;
+    float releaseTime = .65f;
+    float sampleRate = 48000.f;
+    bool noteActive = false;
+    bool noteReleased = false;
+
+    void noteOn ();
+    void noteOff ();
+
+    // current level, without advancing
+    float level () const;
+
+    // next level, advancing by one sample
+    float next ();
+
+    // writes the levels of the next frames to gain, looking at the segment
+    // boundaries only once per segment instead of once per sample
+    void process (float* gain, size_t frames);
+
+    // same as process() without producing any output
+    void advance (size_t frames);
+
+    private:
+        void enter (Stage stage);
+
+    private:
+        Stage _stage = Idle;
+        float _level = .0f;
+        float _target = .0f;
+        float _multiplier = 1.f;
+        float _increment = .0f;
+        size_t _remaining = 0;
+};
+
+#endif // _ENVELOPE_H
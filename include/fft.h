@@ -0,0 +1,69 @@
+#ifndef _FFT_H
+#define _FFT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Everything a forward FFT of one size needs, computed once: the
+// bit-reversal permutation, the twiddle-factors of each stage laid out one
+// after another and the buffers the transform works in. The transform itself
+// is iterative and in place, starts with a radix-4 pass needing no
+// multiplications and runs the remaining radix-2 stages four butterflies at
+// a time with SSE2 or NEON. It never allocates.
+class FftPlan
+{
+    public:
+        // size has to be a power of two of at least 4
+        explicit FftPlan (size_t size);
+
+        size_t size () const;
+
+        // input and output of transform(), size() values each
+        float* real ();
+        float* imag ();
+
+        void transform ();
+
+    private:
+        size_t _size;
+        std::vector<uint32_t> _reversed;
+        // the stage with half-size h starts at h - 4, for h = 4..size/2
+        std::vector<float> _twiddleReal;
+        std::vector<float> _twiddleImag;
+        std::vector<float> _real;
+        std::vector<float> _imag;
+};
+
+// Forward FFT of size real values through a complex one of half the size:
+// the even values go into the real, the odd ones into the imaginary parts
+// and the spectra of both halves are separated again afterwards. Only the
+// size/2 + 1 bins up to Nyquist are computed, the rest mirror them.
+class RealFftPlan
+{
+    public:
+        // size has to be a power of two of at least 8
+        explicit RealFftPlan (size_t size);
+
+        size_t size () const;
+
+        // size() values going in
+        float* input ();
+        // size()/2 + 1 bins coming out
+        const float* real () const;
+        const float* imag () const;
+
+        void transform ();
+
+    private:
+        size_t _size;
+        FftPlan _half;
+        std::vector<float> _input;
+        // e^(-2 pi i k/size) for k = 0..size/2
+        std::vector<float> _twiddleReal;
+        std::vector<float> _twiddleImag;
+        std::vector<float> _real;
+        std::vector<float> _imag;
+};
+
+#endif // _FFT_H
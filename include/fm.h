@@ -0,0 +1,53 @@
+#ifndef _FM_H
+#define _FM_H
+
+#include "oscillator.h"
+
+#define FM_OPERATORS 6
+#define FM_ALGORITHMS 6
+
+// Routing of the operators. Like on the classic 6-operator FM-synths
+// operators are evaluated from the highest to the lowest index, so only a
+// higher operator can modulate a lower one. The highest operator has a
+// feedback-path onto itself.
+struct FmAlgorithm
+{
+    // bit j set in modulators[i] means operator j modulates operator i
+    unsigned char modulators[FM_OPERATORS];
+    // bit i set means operator i is heard
+    unsigned char carriers;
+};
+
+extern const FmAlgorithm fmAlgorithms[FM_ALGORITHMS];
+
+struct FmPatch
+{
+    int algorithm = 1;
+    // frequency of each operator as a multiple of the note-pitch
+    float ratio[FM_OPERATORS] = {1.f, 1.f, 3.f, 1.f, 14.f, 1.f};
+    // output-level of a carrier, resp. modulation-depth in cycles of a
+    // modulator, operators with a level of 0 cost nothing but their phase
+    float level[FM_OPERATORS] = {.5f, .35f, .2f, .5f, .15f, .25f};
+    float feedback = .1f;
+};
+
+// per-channel state of a sounding note
+struct FmVoice
+{
+    Oscillator operators[FM_OPERATORS];
+    float feedback[2] = {.0f, .0f};
+};
+
+void fmSetPitch (FmVoice& voice,
+                 const FmPatch& patch,
+                 float frequency,
+                 float secondPerTick);
+
+// renders one sample looking the operator-waves up in sine, brightness
+// scales the modulation-depth of all modulators
+float fmRender (FmVoice& voice,
+                const FmPatch& patch,
+                const float* sine,
+                float brightness);
+
+#endif // _FM_H
@@ -0,0 +1,42 @@
+#ifndef _KERNELS_H
+#define _KERNELS_H
+
+#include <cstddef>
+
+#include "oscillator.h"
+
+// Block-processing kernels of the voice render path. With SSE2 or NEON at
+// hand they process four frames per instruction, otherwise a scalar fallback
+// steps through exactly the same arithmetic lane by lane, so both produce
+// the same output.
+
+// frames processed in one go on the stack of fillVoiceBuffer
+#define KERNEL_BLOCK 256
+#define KERNEL_LANES 4
+
+// writes the phase of osc for the next frames and advances it accordingly
+void kernelPhases (float* phases, Oscillator& osc, size_t frames);
+
+// out += customSin (phases)
+void kernelSine (float* out, const float* phases, size_t frames);
+
+// out += interpolated lookup of phases in table
+void kernelWavetable (float* out,
+                      const float* table,
+                      const float* phases,
+                      size_t frames);
+
+// interleaves left and right into stereo, scaling each frame by gain
+void kernelInterleaveGain (float* stereo,
+                           const float* left,
+                           const float* right,
+                           const float* gain,
+                           size_t frames);
+
+// data *= factor
+void kernelScale (float* data, float factor, size_t samples);
+
+// out += in, for samples
+void kernelAccumulate (float* out, const float* in, size_t samples);
+
+#endif // _KERNELS_H
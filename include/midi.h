@@ -2,7 +2,6 @@
 #define _MIDI_H
 
 #include <string>
-#include <tuple>
 
 #include <alsa/asoundlib.h>
 
@@ -25,7 +24,15 @@ enum PadColor { Black = 0x00,
 				Cyan = 0x14,
 				White = 0x7F };
 
-using  MessageData = std::tuple<MessageType, char, char, float>;
+// compact, trivially copyable message as it travels from the MIDI-thread to
+// the UI-thread, timeStamp is the arrival in seconds of steady_clock
+struct MidiEvent
+{
+	MessageType type;
+	unsigned char noteId;
+	unsigned char velocity;
+	double timeStamp;
+};
 
 class Midi
 {
@@ -34,7 +41,7 @@ class Midi
 		~Midi ();
 
 		bool initialized () const;
-		MessageData read () const;
+		MidiEvent read () const;
 		void setPadColor (const unsigned char padNum,
 						  const PadColor color) const;
 		void padColorCycle () const;
@@ -0,0 +1,24 @@
+#ifndef _OFFLINE_H
+#define _OFFLINE_H
+
+#include <string>
+
+// Renders a Standard MIDI File or an event-script straight into a 32-bit
+// float stereo WAV-file, no window, audio- or MIDI-device involved, as fast
+// as the CPU allows. Each line of a script is "<seconds> <command>
+// <arguments>", # starts a comment:
+//
+//   0.0 instrument 5      F1..F5, F8, F10 as 0..6
+//   0.0 algorithm 3       FM-algorithm 1..6
+//   0.0 steal oldest      oldest, quietest, same-note or release-first
+//   0.0 volume .2
+//   0.0 dirty 1
+//   0.5 on 60 100         MIDI-note and -velocity (defaults to 100)
+//   1.5 off 60
+//
+// Notes are placed on their exact frame, the other commands take effect at
+// the start of the block they fall into. Rendering stops once the script is
+// done and all notes faded out. Returns false if either file is unusable.
+bool renderOffline (const std::string& eventFile, const std::string& wavFile);
+
+#endif // _OFFLINE_H
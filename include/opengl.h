@@ -3,6 +3,34 @@
 
 #include <SDL_opengl.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// regions of the streaming sample-buffer, the GPU may still be reading the
+// previous ones while the next is written
+#define STREAM_REGIONS 3
+// directory of the linked shader-programs, if set, instead of the user's
+// cache-directory
+#define PROGRAM_CACHE_VARIABLE "SYNTH_PROGRAM_CACHE"
+#define PROGRAM_CACHE_MAGIC 0x53505042
+
+// rows of spectrum-history the spectrogram shows, one per analysed window
+#define SPECTROGRAM_ROWS 512
+// entries of the spectrogram's colour-table
+#define SPECTROGRAM_COLORS 256
+
+enum DisplayMode {
+    ScopeDisplay = 0,
+    SpectrumDisplay,
+    SpectrogramDisplay,
+    DISPLAY_MODES
+};
+
+extern const char* displayModeNames[];
+
 class OpenGL
 {
     public:
@@ -10,13 +38,31 @@ class OpenGL
                 unsigned int height);
         ~OpenGL ();
  
-        bool init (size_t audioBufferSize, size_t frequencyBins);
+        bool init (size_t scopeColumns, size_t frequencyBins);
         bool resize (unsigned int width, unsigned int height);
-        bool draw (std::vector<float>& sampleBufferForDrawing,
-                   std::vector<float>& fftBufferForDrawing,
-                   bool doFFT);
+        bool draw (const std::vector<float>& sampleBufferForDrawing,
+                   const std::vector<float>& fftBufferForDrawing,
+                   DisplayMode mode);
+        // scrolls the spectrogram by a row of these magnitudes, one per
+        // analysed window, at the even indices like the spectrum
+        void addSpectrogramRow (const std::vector<float>& spectrum);
+        // CPU-time spent in draw() per frame
+        void dump (std::ostream& out) const;
 
     private:
+        void drawLine (const std::vector<float>& source,
+                       size_t stride,
+                       float step,
+                       float offset);
+        void drawSpectrogram ();
+        GLfloat* beginSamples ();
+        void endSamples ();
+
+        GLuint createCachedProgram (const char* vertSrc, const char* fragSrc);
+        std::string programCachePath (const char* vertSrc, const char* fragSrc) const;
+        GLuint loadProgramBinary (const std::string& path) const;
+        void storeProgramBinary (GLuint program, const std::string& path) const;
+
         GLuint loadShader (const char *src, GLenum type);
         GLuint createShaderProgram (const char* vertSrc,
                                     const char* fragSrc,
@@ -26,11 +72,35 @@ class OpenGL
     private:
         unsigned int _width;
         unsigned int _height;
-        size_t _audioBufferSize;
         GLuint _vShaderId;
         GLuint _fShaderId;
         GLuint _program;
         GLuint _vao;
-        GLuint _vbo;
+        // what is drawn, read by the vertex-shader through a buffer-texture
+        GLuint _samples;
+        GLuint _samplesTexture;
+        GLint _firstLocation;
+        GLint _stepLocation;
+        GLint _offsetLocation;
+
+        // vertices per region, the current one
+        size_t _vertexCapacity = 0;
+        size_t _region = 0;
+        // persistently mapped regions, nullptr if the buffer is orphaned
+        // and mapped anew each frame instead
+        GLfloat* _mapped = nullptr;
+        GLsync _fences[STREAM_REGIONS] = {};
+
+        // the history is a ring of rows, only the newest one is uploaded
+        GLuint _spectrogramProgram;
+        GLuint _spectrogram;
+        GLuint _spectrogramColors;
+        GLint _scrollLocation;
+        size_t _spectrogramBins = 0;
+        size_t _spectrogramRow = 0;
+
+        size_t _frames = 0;
+        double _drawMicrosecondsSum = .0;
+        float _drawMicrosecondsMax = .0f;
 };
 #endif // _OPENGL_H
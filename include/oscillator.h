@@ -0,0 +1,57 @@
+#ifndef _OSCILLATOR_H
+#define _OSCILLATOR_H
+
+#include <cmath>
+
+// Phase-accumulator state of a single oscillator. The phase is measured in
+// cycles and always wrapped to [0..1), so neither its precision nor the pitch
+// depend on how long the program has been running.
+struct Oscillator
+{
+    float phase = .0f;
+    float increment = .0f;
+
+    void setFrequency (float frequency, float secondPerTick)
+    {
+        increment = frequency*secondPerTick;
+        increment -= floorf (increment);
+    }
+
+    // returns the current phase and steps to the next sample
+    float advance ()
+    {
+        float current = phase;
+        phase += increment;
+        if (phase >= 1.f) {
+            phase -= 1.f;
+        }
+        return current;
+    }
+};
+
+// cheap polynomial sine-approximation, expects the phase in cycles [0..1)
+inline float customSin (float phase)
+{
+    float x = phase;
+    return 20.785f*x*(x*x  - 1.5f*x + .5f);
+    // return sinf (2.f*M_PI*phase);
+}
+
+// The harmonic recipe of oscSine() and the wavetables: partials 1..harmonics
+// with an amplitude of 1/n, either all of them (even) or only the odd ones.
+// Calls partial(harmonic, amplitude) for each, lowest first, until it
+// returns false.
+template <typename Partial>
+inline void forEachPartial (int harmonics, bool even, Partial partial)
+{
+    float maxHarmonics = static_cast<float> (harmonics);
+
+    for (float i = .0f; i < maxHarmonics; (even ? i += 1.f : i += 2.f)) {
+        float harmonic = 1.f + i;
+        if (!partial (harmonic, 1.f/harmonic)) {
+            return;
+        }
+    }
+}
+
+#endif // _OSCILLATOR_H
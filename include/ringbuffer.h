@@ -0,0 +1,80 @@
+#ifndef _RINGBUFFER_H
+#define _RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Fixed-capacity, wait-free ring for exactly one producer- and one
+// consumer-thread. Storage is allocated once on construction, push() and
+// pop() never block, allocate or make a syscall. Items which do not fit are
+// dropped and counted, so the capacity can be sized after the fact.
+template <typename T>
+class RingBuffer
+{
+    public:
+        // capacity is rounded up to a power of two, each slot starts as a
+        // copy of initial so items of the same size are copied in place
+        explicit RingBuffer (size_t capacity, const T& initial = T ())
+        {
+            size_t size = 1;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            _items.resize (size, initial);
+            _mask = size - 1;
+        }
+
+        // producer-side
+        bool push (const T& item)
+        {
+            size_t head = _head.load (std::memory_order_relaxed);
+            size_t tail = _tail.load (std::memory_order_acquire);
+
+            if (head - tail > _mask) {
+                _overflows.fetch_add (1, std::memory_order_relaxed);
+                return false;
+            }
+
+            _items[head & _mask] = item;
+            _head.store (head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer-side
+        bool pop (T& item)
+        {
+            size_t tail = _tail.load (std::memory_order_relaxed);
+            size_t head = _head.load (std::memory_order_acquire);
+
+            if (tail == head) {
+                return false;
+            }
+
+            item = _items[tail & _mask];
+            _tail.store (tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t capacity () const
+        {
+            return _mask + 1;
+        }
+
+        // number of items dropped because the ring was full
+        size_t overflows () const
+        {
+            return _overflows.load (std::memory_order_relaxed);
+        }
+
+    private:
+        std::vector<T> _items;
+        size_t _mask = 0;
+        // producer and consumer each write one index, keep them on separate
+        // cache-lines so they do not contend
+        alignas(64) std::atomic<size_t> _head {0};
+        alignas(64) std::atomic<size_t> _tail {0};
+        std::atomic<size_t> _overflows {0};
+};
+
+#endif // _RINGBUFFER_H
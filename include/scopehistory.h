@@ -0,0 +1,51 @@
+#ifndef _SCOPEHISTORY_H
+#define _SCOPEHISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// each level of the pyramid sums up this many entries of the one below
+#define SCOPE_PYRAMID_FACTOR 4
+#define SCOPE_PYRAMID_SHIFT 2
+
+// Seconds of one channel for a scope: a ring of the raw samples and above
+// it a pyramid of minima and maxima, each level over SCOPE_PYRAMID_FACTOR
+// times as many samples as the one below and covering the same time. Both
+// are brought up to date as blocks come in, so the minimum and maximum of
+// any span take a few entries per level, however long the span is.
+class ScopeHistory
+{
+    public:
+        // frames is rounded up to a power of two
+        explicit ScopeHistory (size_t frames);
+
+        size_t capacity () const;
+
+        // the samples at every stride-th value
+        void append (const float* samples, size_t frames, size_t stride);
+        uint64_t written () const;
+
+        // minimum and maximum of each of columns equal parts of the span
+        // frames before end, pairwise into out. Frames no longer or not yet
+        // in the history count as silence.
+        void columns (uint64_t end, size_t span, float* out, size_t columns) const;
+
+        // the most recent frame before end where the signal rises through
+        // zero, looking at most search frames back, else end itself
+        uint64_t trigger (uint64_t end, size_t search) const;
+
+    private:
+        void minMax (uint64_t begin, uint64_t end, float& minimum, float& maximum) const;
+
+    private:
+        size_t _capacity;
+        uint64_t _written = 0;
+        std::vector<float> _samples;
+        // level l, from 1 on, holds capacity >> l*SCOPE_PYRAMID_SHIFT entries
+        // of the frames [i << l*SCOPE_PYRAMID_SHIFT, (i + 1) << ...)
+        std::vector<std::vector<float>> _minima;
+        std::vector<std::vector<float>> _maxima;
+};
+
+#endif // _SCOPEHISTORY_H
@@ -1,21 +1,23 @@
 #ifndef _SHADERS_H
 #define _SHADERS_H
 
-#define GLSL(src) "#version 130\n" #src
+#define GLSL(src) "#version 140\n" #src
 
+// one vertex per sample, x follows from its index, y is the sample
 const char vert[] = GLSL(
-    attribute vec2 aPosition;
-    attribute vec2 aTexCoord;
-    out vec2 fragCoord;
+    uniform samplerBuffer uSamples;
+    uniform int uFirst;
+    uniform float uStep;
+    uniform float uOffset;
+
     void main()
-    {    
-        gl_Position = vec4 (aPosition, -1.0, 1.0);
-        fragCoord = aTexCoord;
-    }    
+    {
+        float y = texelFetch (uSamples, uFirst + gl_VertexID).r + uOffset;
+        gl_Position = vec4 (float (gl_VertexID)*uStep - 1.0, y, -1.0, 1.0);
+    }
 );
 
 const char frag[] = GLSL(
-	in vec2 fragCoord;
     out vec4 fragColor;
 
     void main()
@@ -24,4 +26,32 @@ const char frag[] = GLSL(
     }    
 );
 
+// a quad over the whole view, from gl_VertexID as well
+const char spectrogramVert[] = GLSL(
+    out vec2 coord;
+
+    void main()
+    {
+        coord = vec2 (gl_VertexID & 1, gl_VertexID >> 1);
+        gl_Position = vec4(2.0*coord - 1.0, -1.0, 1.0);
+    }
+);
+
+// newest row at the top. The magnitudes go through the colour-table on a
+// logarithmic scale of 72 dB below 1.
+const char spectrogramFrag[] = GLSL(
+    uniform sampler2D uHistory;
+    uniform sampler1D uColors;
+    uniform float uScroll;
+    in vec2 coord;
+    out vec4 fragColor;
+
+    void main()
+    {
+        float magnitude = texture (uHistory, vec2 (coord.x, fract (uScroll + coord.y))).r;
+        float level = 1.0 + 20.0*log (max (magnitude, 1e-6))/log (10.0)/72.0;
+        fragColor = texture (uColors, clamp (level, 0.0, 1.0));
+    }
+);
+
 #endif // _SHADERS_H
@@ -0,0 +1,63 @@
+#ifndef _SMF_H
+#define _SMF_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "midi.h"
+
+// bytes of track-data each track keeps read ahead
+#define SMF_BUFFER 4096
+
+// Streaming reader of Standard MIDI Files of type 0 and 1. Only the chunk
+// headers are looked at when opening, each track is then read through a small
+// window of its own while playing, so even huge files start right away. The
+// tracks are merged in the order of their ticks and converted to seconds
+// along the tempo-map as the tempo-changes come by.
+class Smf
+{
+    public:
+        bool open (const std::string& path);
+
+        // next note-on/-off of all tracks, timeStamp in seconds from the
+        // start of the file, false once all tracks ended
+        bool next (MidiEvent& event);
+
+        // false if the file was no SMF or a track turned out to be broken
+        bool good () const;
+
+    private:
+        struct Track
+        {
+            uint64_t position;
+            uint64_t end;
+            uint64_t tick;
+            unsigned char status;
+            bool done;
+            size_t cursor;
+            size_t fill;
+            unsigned char buffer[SMF_BUFFER];
+        };
+
+        bool readByte (Track& track, unsigned char& byte);
+        bool readVariable (Track& track, uint32_t& value);
+        bool skip (Track& track, uint32_t bytes);
+        void readDelta (Track& track);
+        bool readEvent (Track& track, MidiEvent& event, bool& isNote);
+        double seconds (uint64_t tick) const;
+
+    private:
+        std::ifstream _file;
+        std::vector<Track> _tracks;
+        bool _good = false;
+        uint16_t _division = 96;
+        // the tempo-map up to the last tempo-change seen
+        uint64_t _tempoTick = 0;
+        double _tempoSeconds = .0;
+        double _secondsPerTick = .5/96.;
+        bool _smpte = false;
+};
+
+#endif // _SMF_H
@@ -0,0 +1,222 @@
+#ifndef _SYNTH_H
+#define _SYNTH_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "analyzer.h"
+#include "dspmonitor.h"
+#include "envelope.h"
+#include "fm.h"
+#include "midi.h"
+#include "oscillator.h"
+#include "ringbuffer.h"
+#include "voicebank.h"
+#include "wavetable.h"
+#include "workerpool.h"
+
+using std::vector;
+using std::shared_ptr;
+
+using NoteId = int;
+
+#define OSCILLATORS_PER_NOTE 8
+
+struct Note
+{
+    NoteId noteId;
+    int voice;
+    Envelope amplitudeADSR;
+    Envelope filterADSR;
+    float velocity = 1.f;
+    // order of the note-on, for stealing the oldest voice
+    unsigned long started = 0;
+    // fading out after its voice was stolen, no longer reachable by noteId
+    bool stolen = false;
+    Oscillator oscillators[OSCILLATORS_PER_NOTE];
+    FmVoice fm[2];
+};
+
+// MIDI-notes 0..127 map to the NoteIds -20..107
+#define NOTE_ID_OFFSET 20
+#define MAX_NOTE_IDS 128
+
+// spare voices a stolen note fades out on while its successor already plays
+#define STEAL_FADE_VOICES 4
+#define STEAL_FADE_TIME .003f
+
+// which voice gives way to a new note once all voices are sounding
+enum StealPolicy { StealOldest = 0,
+                   StealQuietest,
+                   // a repeated note restarts its own voice even while held
+                   StealSameNote,
+                   // released voices go first, the quietest of them
+                   StealReleaseFirst,
+                   STEAL_POLICIES };
+
+extern const char* stealPolicyNames[STEAL_POLICIES];
+
+// Owns a fixed set of Note-slots, one per voice, allocated up front. A
+// sounding note is found through a direct NoteId-to-voice index and the
+// sounding voices are kept in a dense list, so note-on/-off never allocate
+// and cost the same no matter how many voices are busy.
+// No more than maxVoices notes sound at once, a note beyond that steals a
+// voice according to the policy. The stolen note fades out within a few
+// milliseconds on one of the spare voices instead of being cut off.
+class Synth
+{
+    public:
+        explicit Synth(unsigned int maxVoices = 16,
+                       float sampleRate = 48000.f);
+
+        void setStealPolicy (StealPolicy policy);
+        StealPolicy stealPolicy () const;
+
+        // voices including the spare ones for fading out
+        size_t voices () const;
+
+        // counted on the audio-thread, readable from any thread
+        unsigned long steals () const;
+        unsigned long retriggers () const;
+        unsigned long hardCuts () const;
+
+        void addNoteMidi(NoteId noteId, float velocity);
+        void removeNoteMidi(NoteId noteId, float velocity);
+
+        // frees the voices of all notes which have faded out
+        void clearNotes ();
+
+        // the sounding notes are 0..activeNotes()-1
+        size_t activeNotes () const;
+        Note& activeNote (size_t index);
+
+    private:
+        Note* findNote (NoteId noteId);
+        int allocVoice();
+        void freeVoice(int voice);
+        int chooseVictim () const;
+        void fadeOut (Note& note);
+        int reclaimFading ();
+
+    private:
+        vector<Note> _voices;
+        vector<int> _voiceOfNote;
+        vector<int> _active;
+        vector<int> _freeVoices;
+        unsigned int _maxVoices;
+        float _sampleRate;
+        StealPolicy _stealPolicy = StealReleaseFirst;
+        // notes sounding without the ones fading out
+        unsigned int _sounding = 0;
+        unsigned long _noteCounter = 0;
+        std::atomic<unsigned long> _steals {0};
+        std::atomic<unsigned long> _retriggers {0};
+        std::atomic<unsigned long> _hardCuts {0};
+};
+
+#define MAX_PENDING_EVENTS 1024
+// the last pending events only note-offs may take, so a flood of note-ons
+// cannot keep notes from stopping
+#define NOTE_OFF_RESERVE 64
+#define COMMAND_CAPACITY 1024
+// a callback coming this many blocks after the last one means the device
+// was paused or stalled, the stream picks up from there anew
+#define STREAM_GAP_BLOCKS 4
+
+enum CommandType { NoteOnCommand = 0,
+                   NoteOffCommand,
+                   SetInstrument,
+                   SetVolume,
+                   SetDirty,
+                   SetFmAlgorithm,
+                   SetStealPolicy };
+
+// everything the UI-thread changes about the synth travels as one of these
+// to the audio-thread, value is the velocity of a note or the new setting
+struct SynthCommand
+{
+    CommandType type;
+    NoteId noteId;
+    float value;
+    double timeStamp;
+};
+
+// note-on/-off to be applied by the audio-callback at an exact frame of the
+// audio-stream
+struct SynthEvent
+{
+    uint64_t frame;
+    MessageType type;
+    NoteId noteId;
+    float velocity;
+};
+
+struct SynthData
+{
+    float sampleRate;
+    size_t channels;
+    size_t samples;
+    float volume;
+    short instrument;
+    bool makeDirty;
+    shared_ptr<vector<vector<float>>> voiceBuffers;
+    shared_ptr<WorkerPool> workerPool;
+    shared_ptr<Wavetable> squareTable;
+    shared_ptr<Wavetable> sawtoothTable;
+    shared_ptr<Wavetable> sineTable;
+    FmPatch fmPatch;
+    shared_ptr<VoiceBank> voiceBank;
+    // per voice, the note (by Note::started) its lanes in the voice-bank
+    // play, 0 for none, and whether that note is still there this block
+    vector<unsigned long> padNotes;
+    vector<char> padSounding;
+    shared_ptr<Analyzer> analyzer;
+    shared_ptr<DspMonitor> monitor;
+    Synth* synth;
+    RingBuffer<SynthCommand>* commands;
+    vector<SynthEvent> events;
+    // events that did not fit, counted by the audio-thread. A note-on is
+    // dropped, a note-off applied right away at the start of the block.
+    std::atomic<unsigned long> droppedNoteOns {0};
+    std::atomic<unsigned long> earlyNoteOffs {0};
+    // frames rendered so far and the time the last block was rendered at
+    uint64_t frames;
+    double blockTime;
+    // when the stream last picked up after a gap, note-ons stamped before
+    // are stale
+    double resumeTime;
+};
+
+// the building blocks of renderSynth(), exposed for the benchmarks
+float keyToPitch (int key, float detune = .0f /* 0..100 */);
+float oscSine (float phase, int harmonics = 1, bool even = true);
+void fillVoiceBuffer (int instrument,
+                      float* buffer,
+                      size_t frames,
+                      Note& note,
+                      const SynthData& synthData,
+                      float secondPerTick,
+                      float detuneLeft,
+                      float detuneRight,
+                      bool makeDirty);
+
+// creates the worker-pool, tables, voice-bank and buffers the rendering of
+// synth needs and hooks them up in synthData
+void setupSynthData (SynthData& synthData,
+                     Synth& synth,
+                     float sampleRate,
+                     size_t channels,
+                     size_t samples,
+                     size_t frequencyBins);
+
+// Renders the next frames of synthData->synth into sampleBuffer, which has
+// to be zeroed. Pending commands are taken from the ring first, now is the
+// time the block is rendered at on the clock their time-stamps refer to.
+void renderSynth (SynthData& synthData,
+                  float* sampleBuffer,
+                  size_t frames,
+                  double now);
+
+#endif // _SYNTH_H
@@ -0,0 +1,57 @@
+#ifndef _TRIPLEBUFFER_H
+#define _TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Hands complete snapshots from exactly one writer- to one reader-thread.
+// Of the three buffers the writer owns one to fill, the reader one to look
+// at and the third is the latest complete one, exchanged atomically with
+// either side. Neither side ever waits, copies or allocates, the reader
+// always gets the most recent snapshot and never one that is being written.
+template <typename T>
+class TripleBuffer
+{
+    public:
+        explicit TripleBuffer (const T& initial)
+            : _buffers {initial, initial, initial}
+        {
+        }
+
+        // writer-side, the buffer to fill next. It still holds an older
+        // snapshot, not necessarily the last one published.
+        T& back ()
+        {
+            return _buffers[_back];
+        }
+
+        // writer-side, makes back() the latest snapshot
+        void publish ()
+        {
+            uint8_t middle = _middle.exchange (_back | FRESH, std::memory_order_acq_rel);
+            _back = middle & INDEX;
+        }
+
+        // reader-side, the latest snapshot, valid until the next call
+        const T& front ()
+        {
+            if (_middle.load (std::memory_order_relaxed) & FRESH) {
+                uint8_t middle = _middle.exchange (_front, std::memory_order_acq_rel);
+                _front = middle & INDEX;
+            }
+            return _buffers[_front];
+        }
+
+    private:
+        static constexpr uint8_t INDEX = 3;
+        static constexpr uint8_t FRESH = 4;
+
+        T _buffers[3];
+        // index of the latest snapshot, FRESH until the reader took it
+        std::atomic<uint8_t> _middle {2};
+        // each only touched by its own side
+        alignas(64) uint8_t _back = 0;
+        alignas(64) uint8_t _front = 1;
+};
+
+#endif // _TRIPLEBUFFER_H
@@ -0,0 +1,67 @@
+#ifndef _VOICEBANK_H
+#define _VOICEBANK_H
+
+#include <cstddef>
+#include <vector>
+
+// lanes advanced together by one iteration of the render-kernel
+#define VOICEBANK_GROUP 8
+
+// Structure-of-arrays alternative to rendering each Note on its own: the
+// state of all sine-oscillators of all voices is packed into aligned arrays
+// and one kernel advances VOICEBANK_GROUP of them per step. Lanes with an
+// even index are heard on the left, lanes with an odd index on the right.
+// Every lane has its own linear ADSR, which moves from stage to stage once
+// per block and ramps sample by sample in between.
+class VoiceBank
+{
+    public:
+        VoiceBank (size_t lanes, float sampleRate);
+
+        void setFrequency (size_t lane, float frequency);
+        // opens (attack) or closes (release) the envelope of a lane, is a
+        // no-op if the lane already is in that state
+        void gate (size_t lane, bool open, float velocity);
+        // attacks anew from the current level, whatever the state
+        void trigger (size_t lane, float velocity);
+        // to silence within fadeTime, for voices that were stolen
+        void fade (size_t lane);
+        // silent at once
+        void stop (size_t lane);
+        bool active (size_t lane) const;
+        // whether any lane is, the fade of a note outlives the note
+        bool sounding () const;
+        float level (size_t lane) const;
+
+        // adds frames of interleaved stereo to out
+        void render (float* out, size_t frames);
+
+    public:
+        float attackTime = .15f;
+        float decayTime = .2f;
+        float sustainLevel = .8f;
+        float releaseTime = .65f;
+        float fadeTime = .003f;
+
+    private:
+        enum Stage { Idle = 0, Attack, Decay, Sustain, Release, Fade };
+
+        struct alignas(32) Group
+        {
+            float lane[VOICEBANK_GROUP];
+        };
+
+        void advanceEnvelopes (size_t group, size_t frames);
+
+    private:
+        float _secondPerTick;
+        std::vector<Group> _increment;
+        std::vector<Group> _phase;
+        std::vector<Group> _level;
+        std::vector<Group> _step;
+        std::vector<Group> _peak;
+        std::vector<int> _stage;
+        std::vector<int> _activeLanes;
+};
+
+#endif // _VOICEBANK_H
@@ -0,0 +1,43 @@
+#ifndef _WAVETABLE_H
+#define _WAVETABLE_H
+
+#include <vector>
+
+#define WAVETABLE_SIZE 2048
+#define WAVETABLE_OCTAVES 10
+
+// Band-limited single-cycle wave, stored as one table per octave. Each table
+// only holds the partials of the harmonic recipe which stay below Nyquist
+// for the highest pitch it is used for, so playing it back neither aliases
+// nor costs more than one interpolated lookup per sample.
+class Wavetable
+{
+    public:
+        // the partials of forEachPartial(), the same as oscSine()'s
+        Wavetable (int harmonics, bool even);
+
+        // table to use for an oscillator advancing by increment cycles per
+        // sample, is meant to be picked once per block
+        const float* select (float increment) const;
+
+        // linear-interpolated value at phase [0..1)
+        static float lookup (const float* table, float phase)
+        {
+            float position = phase*WAVETABLE_SIZE;
+            int index = static_cast<int> (position);
+            float fraction = position - static_cast<float> (index);
+            return table[index] + fraction*(table[index + 1] - table[index]);
+        }
+
+        float lookup (float phase, float increment) const
+        {
+            return lookup (select (increment), phase);
+        }
+
+    private:
+        // each table carries a copy of its first sample at the end, so
+        // lookup() never has to wrap the index
+        std::vector<float> _tables;
+};
+
+#endif // _WAVETABLE_H
@@ -0,0 +1,58 @@
+#ifndef _WORKERPOOL_H
+#define _WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of pre-started threads the audio-callback hands its per-voice
+// jobs to. All storage is allocated up front and the dispatching thread never
+// takes a lock or sleeps: a batch is published with an atomic generation, the
+// caller claims jobs like any worker - so with none awake it renders them all
+// itself - and spins until the ones taken by workers are done.
+class WorkerPool
+{
+    public:
+        using Job = void (*) (void* context, size_t index);
+
+        WorkerPool (size_t workers, size_t maxJobs);
+        ~WorkerPool ();
+
+        // runs job(context, 0..count-1) on the workers and the calling
+        // thread, returns once all of them are done
+        void run (Job job, void* context, size_t count);
+
+        size_t workers () const;
+
+        // timing of the most recent run(), only valid after it returned
+        float jobMicroseconds (size_t index) const;
+        float runMicroseconds () const;
+
+    private:
+        void work ();
+        void execute (uint32_t generation,
+                      Job job,
+                      void* context,
+                      size_t count);
+
+    private:
+        std::vector<std::thread> _threads;
+        std::mutex _mutex;
+        // only the idle workers sleep on it
+        std::condition_variable _wake;
+        std::atomic<bool> _running {true};
+        uint32_t _generation = 0;
+        std::atomic<Job> _job {nullptr};
+        std::atomic<void*> _context {nullptr};
+        std::atomic<size_t> _count {0};
+        // upper 32 bits hold the generation, lower 32 bits the next job-index
+        std::atomic<uint64_t> _ticket {0};
+        std::atomic<size_t> _pending {0};
+        std::vector<float> _jobMicroseconds;
+        float _runMicroseconds = .0f;
+};
+
+#endif // _WORKERPOOL_H
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "analyzer.h"
+
+const char* spectrumWindowNames[] = {"rectangular", "hann", "blackman-harris"};
+
+Analyzer::Analyzer (size_t size,
+                    size_t channels,
+                    size_t frequencyBins,
+                    size_t blockFrames,
+                    float sampleRate)
+    : _size {size}
+    , _channels {channels}
+    , _scopeColumns {blockFrames}
+    , _scopeSpan {blockFrames}
+    , _scopeHistory (static_cast<size_t> (ANALYZER_SCOPE_SECONDS*sampleRate))
+    , _plan (size,
+             ANALYZER_FROM_FREQUENCY,
+             ANALYZER_TO_FREQUENCY,
+             frequencyBins,
+             sampleRate)
+    , _window (size*channels, .0f)
+    , _frame (frequencyBins*channels, .0f)
+    , _spectrum (frequencyBins*channels, .0f)
+    , _scopes (std::vector<float> (2*ANALYZER_SCOPE_COLUMNS, .0f))
+    , _spectra (_spectrum)
+    , _rows (ANALYZER_ROWS, _frame)
+{
+    _capacity = 1;
+    while (_capacity < ANALYZER_HISTORY*std::max (size, blockFrames)) {
+        _capacity *= 2;
+    }
+    _ring.resize (_capacity*_channels, .0f);
+    _history.resize (_capacity*_channels, .0f);
+}
+
+Analyzer::~Analyzer ()
+{
+    _running = false;
+    if (_thread.joinable ()) {
+        _thread.join ();
+    }
+}
+
+void Analyzer::start ()
+{
+    if (!_running) {
+        _running = true;
+        _thread = std::thread (&Analyzer::run, this);
+    }
+}
+
+void Analyzer::publish (const float* samples, size_t frames)
+{
+    uint64_t written = _written.load (std::memory_order_relaxed);
+    uint64_t read = _read.load (std::memory_order_acquire);
+
+    if (written + frames - read > _capacity) {
+        return;
+    }
+
+    size_t start = static_cast<size_t> (written & (_capacity - 1));
+    size_t first = std::min (frames, _capacity - start);
+    std::memcpy (&_ring[start*_channels], samples, first*_channels*sizeof (float));
+    std::memcpy (&_ring[0],
+                 samples + first*_channels,
+                 (frames - first)*_channels*sizeof (float));
+
+    _written.store (written + frames, std::memory_order_release);
+}
+
+void Analyzer::setSpectrum (bool enabled)
+{
+    _spectrumEnabled = enabled;
+}
+
+void Analyzer::setWindow (SpectrumWindow window)
+{
+    _spectrumWindow = window;
+}
+
+void Analyzer::setScope (size_t columns, size_t span, bool trigger)
+{
+    _scopeColumns = std::min<size_t> (columns, ANALYZER_SCOPE_COLUMNS);
+    _scopeSpan = span;
+    _scopeTrigger = trigger;
+}
+
+size_t Analyzer::scopeHistory () const
+{
+    return _scopeHistory.capacity ();
+}
+
+const std::vector<float>& Analyzer::scope ()
+{
+    return _scopes.front ();
+}
+
+const std::vector<float>& Analyzer::spectrum ()
+{
+    return _spectra.front ();
+}
+
+bool Analyzer::spectrogramRow (std::vector<float>& row)
+{
+    return _rows.pop (row);
+}
+
+// Moves everything the audio-thread has written since into the history and
+// hands the space in the ring back to it.
+uint64_t Analyzer::drain ()
+{
+    uint64_t read = _read.load (std::memory_order_relaxed);
+    uint64_t written = _written.load (std::memory_order_acquire);
+
+    size_t frames = static_cast<size_t> (written - read);
+    size_t start = static_cast<size_t> (read & (_capacity - 1));
+    size_t first = std::min (frames, _capacity - start);
+    std::memcpy (&_history[start*_channels],
+                 &_ring[start*_channels],
+                 first*_channels*sizeof (float));
+    std::memcpy (&_history[0],
+                 &_ring[0],
+                 (frames - first)*_channels*sizeof (float));
+
+    _read.store (written, std::memory_order_release);
+
+    _scopeHistory.append (&_history[start*_channels], first, _channels);
+    _scopeHistory.append (&_history[0], frames - first, _channels);
+    return written;
+}
+
+void Analyzer::takeScope (uint64_t written)
+{
+    size_t columns = _scopeColumns;
+    size_t span = std::min<size_t> (_scopeSpan, _scopeHistory.capacity ());
+    uint64_t end = written;
+    if (_scopeTrigger) {
+        end = _scopeHistory.trigger (written, ANALYZER_TRIGGER_SEARCH);
+    }
+
+    // within the capacity it was created with, so this does not allocate
+    std::vector<float>& out = _scopes.back ();
+    out.resize (2*columns);
+    _scopeHistory.columns (end, span, out.data (), columns);
+    _scopes.publish ();
+}
+
+// the out.size()/channels frames of the history before end
+bool Analyzer::copyFrames (uint64_t end, std::vector<float>& out) const
+{
+    size_t frames = out.size ()/_channels;
+    if (end < frames) {
+        return false;
+    }
+
+    uint64_t begin = end - frames;
+    size_t start = static_cast<size_t> (begin & (_capacity - 1));
+    size_t first = std::min (frames, _capacity - start);
+    std::memcpy (out.data (), &_history[start*_channels], first*_channels*sizeof (float));
+    std::memcpy (out.data () + first*_channels,
+                 &_history[0],
+                 (frames - first)*_channels*sizeof (float));
+    return true;
+}
+
+void Analyzer::run ()
+{
+    uint64_t hop = std::max<uint64_t> (_size/ANALYZER_HOPS, 1);
+
+    while (_running) {
+        std::this_thread::sleep_for (std::chrono::milliseconds (ANALYZER_PERIOD_MS));
+
+        uint64_t written = drain ();
+        takeScope (written);
+
+        if (!_spectrumEnabled || written < _size) {
+            _analyzed = written;
+            continue;
+        }
+
+        // every hop since the last run, as far back as the history reaches
+        uint64_t oldest = written > _capacity/2 ? written - _capacity/2 : 0;
+        uint64_t end = std::max (_analyzed + hop, std::max<uint64_t> (oldest, _size));
+        for (; end <= written; end += hop) {
+            analyze (end);
+            _analyzed = end;
+        }
+
+        // same size, so this does not allocate
+        _spectra.back () = _spectrum;
+        _spectra.publish ();
+    }
+}
+
+void Analyzer::analyze (uint64_t end)
+{
+    copyFrames (end, _window);
+    _plan.setWindow (static_cast<SpectrumWindow> (_spectrumWindow.load ()));
+    computeFastFourierTransform (_plan, _window, _frame, _channels);
+    // same size, so this does not allocate either. Rows the UI-thread does
+    // not take in time are dropped.
+    _rows.push (_frame);
+
+    // peaks of all overlapping windows show up and fall off slowly
+    for (size_t i = 0; i < _spectrum.size (); ++i) {
+        _spectrum[i] = std::max (_frame[i], _spectrum[i]*ANALYZER_DECAY);
+    }
+}
+
+SpectrumPlan::SpectrumPlan (size_t size,
+                            float fromFrequency,
+                            float toFrequency,
+                            size_t frequencyBins,
+                            float sampleRate)
+    : _fft (size)
+    , _windows (SPECTRUM_WINDOWS*size)
+    , _bins (frequencyBins)
+    , _magnitudes (size/2 + 1, .0f)
+{
+    // periodic windows, the sums keep a full-scale sine at the same height
+    // whatever the window
+    for (size_t window = 0; window < SPECTRUM_WINDOWS; ++window) {
+        float* table = &_windows[window*size];
+        double sum = .0;
+        for (size_t i = 0; i < size; ++i) {
+            double phase = 2.*M_PI*static_cast<double> (i)/static_cast<double> (size);
+            double value = 1.;
+            if (window == WindowHann) {
+                value = .5 - .5*cos (phase);
+            } else if (window == WindowBlackmanHarris) {
+                value = .35875 - .48829*cos (phase) + .14128*cos (2.*phase) - .01168*cos (3.*phase);
+            }
+            table[i] = static_cast<float> (value);
+            sum += value;
+        }
+        _scales[window] = static_cast<float> (5./sum);
+    }
+
+    // the lowest bin that is not DC up to Nyquist at most
+    size_t half = size/2;
+    double resolution = sampleRate/static_cast<double> (size);
+    double from = std::max<double> (fromFrequency, resolution);
+    double to = std::min<double> (toFrequency, sampleRate/2.);
+    if (to <= from) {
+        from = resolution;
+        to = sampleRate/2.;
+    }
+
+    double ratio = to/from;
+    for (size_t bin = 0; bin < frequencyBins; ++bin) {
+        double low = from*pow (ratio, static_cast<double> (bin)/frequencyBins)/resolution;
+        double high = from*pow (ratio, static_cast<double> (bin + 1)/frequencyBins)/resolution;
+        SpectrumBin& map = _bins[bin];
+
+        if (high - low < 1.) {
+            double center = std::min (sqrt (low*high), static_cast<double> (half) - 1.);
+            map.first = static_cast<uint32_t> (center);
+            map.last = map.first + 1;
+            map.fraction = static_cast<float> (center - map.first);
+        } else {
+            map.first = static_cast<uint32_t> (std::min (lround (low), static_cast<long> (half) - 1));
+            map.last = static_cast<uint32_t> (std::min (lround (high), static_cast<long> (half) + 1));
+            map.last = std::max (map.last, map.first + 1);
+            map.fraction = .0f;
+        }
+    }
+}
+
+size_t SpectrumPlan::size () const
+{
+    return _fft.size ();
+}
+
+void SpectrumPlan::setWindow (SpectrumWindow window)
+{
+    _window = window;
+}
+
+void computeFastFourierTransform (SpectrumPlan& plan,
+                                  std::vector<float>& sampleBuffer,
+                                  std::vector<float>& fftBuffer,
+                                  size_t channels)
+{
+    size_t size = plan.size ();
+    const float* table = &plan._windows[plan._window*size];
+    float* input = plan._fft.input ();
+
+    size_t frames = std::min (size, sampleBuffer.size ()/channels);
+    for (size_t i = 0; i < frames; ++i) {
+        input[i] = table[i]*sampleBuffer[channels*i];
+    }
+    std::fill (input + frames, input + size, .0f);
+
+    plan._fft.transform ();
+
+    const float* real = plan._fft.real ();
+    const float* imag = plan._fft.imag ();
+    float scale = plan._scales[plan._window];
+    for (size_t i = 0; i < plan._magnitudes.size (); ++i) {
+        plan._magnitudes[i] = scale*sqrtf (real[i]*real[i] + imag[i]*imag[i]);
+    }
+
+    const float* magnitudes = plan._magnitudes.data ();
+    size_t bins = std::min (plan._bins.size (), fftBuffer.size ()/2);
+    for (size_t bin = 0; bin < bins; ++bin) {
+        const SpectrumBin& map = plan._bins[bin];
+        float value;
+        if (map.last - map.first == 1) {
+            value = magnitudes[map.first] +
+                    map.fraction*(magnitudes[map.first + 1] - magnitudes[map.first]);
+        } else {
+            value = *std::max_element (magnitudes + map.first, magnitudes + map.last);
+        }
+        fftBuffer[2*bin] = value;
+    }
+}
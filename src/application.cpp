@@ -1,9 +1,7 @@
 #include <algorithm>
 #include <chrono>
-#include <complex>
 #include <iostream>
 #include <memory>
-#include <mutex>
 #include <numeric>
 #include <sstream>
 #include <thread>
@@ -31,21 +29,9 @@ using std::make_shared;
 #define NOTE_B   51
 #define NOTE_C2  52
 
-std::mutex synthDataMutex;
-std::mutex midiMessageQueueMutex;
-
-static float elapsedSeconds ()
+static double secondsNow ()
 {
-    return static_cast<float>(SDL_GetTicks())*.001;
-}
-
-float keyToPitch (int key, float detune = .0f /* 0..100 */)
-{
-    // using A4 with 440Hz as the base, key = 1 is an A0
-    float fkey = static_cast<float> (key);
-    fkey += detune*.01f;
-    float pitch = pow(2.f, (fkey - 49.f)/12.f)*440.f;
-    return pitch;
+    return duration<double> (steady_clock::now ().time_since_epoch ()).count ();
 }
 
 void Application::initialize ()
@@ -62,18 +48,19 @@ void Application::initialize ()
         return;
     }
 
-    _sampleBufferForDrawing.reserve (_sampleBufferSize*_channels);
-
-    std::fill(_sampleBufferForDrawing.begin(),
-              _sampleBufferForDrawing.end(),
-              .0f);
+    setupSynthData (_synthData,
+                    _synth,
+                    _sampleRate,
+                    _channels,
+                    _sampleBufferSize,
+                    _frequencyBins);
 
     _initialized = true;
 
 	if (_midi.initialized()) {
         std::thread midiKeyReadingThread (readMidiKeys,
 										  std::ref (_midi),
-										  std::ref(_midiMessageQueue));
+										  std::ref(_midiEvents));
         midiKeyReadingThread.detach();
 	}
 
@@ -83,387 +70,80 @@ void Application::initialize ()
     }
 }
 
-void Application::disco (const Midi& midi)
+void Application::playSmf (Smf& smf,
+                           RingBuffer<MidiEvent>& smfEvents,
+                           std::atomic<bool>& playing)
 {
-    while (true) {
-        midi.padColorCycle();
+    double start = secondsNow () + SMF_LOOKAHEAD;
+    MidiEvent event;
+
+    // notes go out a little ahead of time, the audio-thread then starts them
+    // on the exact frame of their time-stamp
+    while (playing && smf.next (event)) {
+        event.timeStamp += start;
+        while (playing && event.timeStamp - secondsNow () > SMF_LOOKAHEAD) {
+            std::this_thread::sleep_for (milliseconds (5));
+        }
+        while (playing && !smfEvents.push (event)) {
+            std::this_thread::sleep_for (milliseconds (1));
+        }
     }
-}
 
-void Application::readMidiKeys(const Midi& midi, std::queue<MessageData>& queue)
-{
-    while (true) {
-        MessageData messageData = midi.read();
-        std::lock_guard<std::mutex> guard(midiMessageQueueMutex);
-        queue.push (messageData);
+    if (!smf.good ()) {
+        cout << "MIDI-file is broken, played what could be read" << newline;
     }
 }
 
-float w(float hertz)
-{
-    return 2.f*M_PI*hertz;
-}
-
-float customSin (float value)
-{
-    float x = value * .5f/M_PI;
-    x -= floorf(x);
-    return 20.785f*x*(x*x  - 1.5f*x + .5f);
-    // return sinf (value);
-}
-
-float oscSine (float baseFrequency,
-               float timeInSeconds,
-               int harmonics = 1,
-               bool even = true) {
-    float result = .0f;
-    float amplitude = 1.f;
-    float harmonic = 1.f;
-    float maxHarmonics = static_cast<float>(harmonics);
-
-    for (float i = .0f; i < maxHarmonics; (even ? i += 1.f : i += 2.f)) {
-        harmonic = 1.f + i;
-        amplitude = 1.f/harmonic;
-        float frequency = baseFrequency*harmonic;
-        result += amplitude*customSin (w(frequency)*timeInSeconds);
-    }
-
-    return result;
-}
-
-float oscNoise ()
-{
-    return (float) random() / (float) RAND_MAX;
-}
-
-float oscSawtooth (float freq, float timeInSeconds, int harmonics = 32)
-{
-    return oscSine (freq, timeInSeconds, harmonics, true);
-}
-
-float oscSquare (float freq, float timeInSeconds, int harmonics = 64)
-{
-    return oscSine (freq, timeInSeconds, harmonics, false);
-}
-
-void fillVoiceBuffer (int instrument,
-                      std::vector<float>& buffer,
-                      Note& note,
-                      int ticks,
-                      float secondPerTick,
-                      float detuneLeft,
-                      float detuneRight,
-                      bool makeDirty)
+void Application::disco (const Midi& midi)
 {
-    for (int i = 0; i < buffer.size(); i += 2) {
-        int left = i;
-        int right = i + 1;
-        float timeInSeconds = static_cast<float> (ticks + i/2) * secondPerTick;
-        float level = note.amplitudeADSR.level (elapsedSeconds());
-
-        level *= note.velocity;
-        buffer[left] = .0f;
-        buffer[right] = .0f;
-
-        switch (instrument) {
-            case 0 : {
-                buffer[left]  = oscSine (keyToPitch (note.noteId,
-                                                     detuneLeft),
-                                         timeInSeconds);
-                buffer[right] = oscSine (keyToPitch (note.noteId,
-                                                     detuneRight),
-                                         timeInSeconds);
-
-                buffer[left]  += oscSine (keyToPitch (note.noteId,
-                                                      detuneLeft*1.5f),
-                                          timeInSeconds);
-                buffer[right] += oscSine (keyToPitch (note.noteId,
-                                                      detuneRight*1.5f),
-                                          timeInSeconds);
-
-                buffer[left]  += oscSine (keyToPitch (note.noteId,
-                                                      detuneLeft*3.f),
-                                          timeInSeconds);
-                buffer[right] += oscSine (keyToPitch (note.noteId,
-                                                      detuneRight*3.f),
-                                          timeInSeconds);
-
-                buffer[left]  += oscSine (keyToPitch (note.noteId,
-                                                      detuneLeft*4.5f),
-                                          timeInSeconds);
-                buffer[right] += oscSine (keyToPitch (note.noteId,
-                                                      detuneRight*4.5f),
-                                          timeInSeconds);
-                break;
-            }
-
-            case 1 : {
-                buffer[left]  = oscSquare (keyToPitch (note.noteId,
-                                                       detuneLeft),
-                                           timeInSeconds);
-                buffer[right] = oscSquare (keyToPitch (note.noteId,
-                                                       detuneRight),
-                                           timeInSeconds);
-
-                buffer[left]  += oscSquare (keyToPitch (note.noteId,
-                                                        detuneLeft*1.5f),
-                                            timeInSeconds);
-                buffer[right] += oscSquare (keyToPitch (note.noteId,
-                                                        detuneRight*1.5f),
-                                            timeInSeconds);
-
-                buffer[left]  += oscSquare (keyToPitch (note.noteId,
-                                                        detuneLeft*3.f),
-                                            timeInSeconds);
-                buffer[right] += oscSquare (keyToPitch (note.noteId,
-                                                        detuneRight*3.f),
-                                            timeInSeconds);
-
-                buffer[left]  += oscSquare (keyToPitch (note.noteId,
-                                                        detuneLeft*4.5f),
-                                            timeInSeconds);
-                buffer[right] += oscSquare (keyToPitch (note.noteId,
-                                                        detuneRight*4.5f),
-                                            timeInSeconds);
-                break;
-            }
-
-            case 2 : {
-                buffer[left]  = oscSawtooth (keyToPitch (note.noteId,
-                                                         detuneLeft),
-                                             timeInSeconds);
-                buffer[right] = oscSawtooth (keyToPitch (note.noteId,
-                                                         detuneRight),
-                                             timeInSeconds);
-
-                buffer[left]  += oscSawtooth (keyToPitch (note.noteId,
-                                                          detuneLeft*1.5f),
-                                              timeInSeconds);
-                buffer[right] += oscSawtooth (keyToPitch (note.noteId,
-                                                          detuneRight*1.5f),
-                                              timeInSeconds);
-
-                buffer[left]  += oscSawtooth (keyToPitch (note.noteId,
-                                                          detuneLeft*3.f),
-                                              timeInSeconds);
-                buffer[right] += oscSawtooth (keyToPitch (note.noteId,
-                                                          detuneRight*3.f),
-                                              timeInSeconds);
-
-                buffer[left]  += oscSawtooth (keyToPitch (note.noteId,
-                                                          detuneLeft*4.5f),
-                                              timeInSeconds);
-                buffer[right] += oscSawtooth (keyToPitch (note.noteId,
-                                                          detuneRight*4.5f),
-                                              timeInSeconds);
-                break;
-            }
-
-            case 3 : {
-                buffer[left]  = oscSawtooth (keyToPitch (note.noteId,
-                                                         detuneLeft),
-                                             timeInSeconds);
-                buffer[right] = oscSquare (keyToPitch (note.noteId,
-                                                       detuneRight),
-                                           timeInSeconds);
-
-                buffer[left]  += oscSawtooth (keyToPitch (note.noteId,
-                                                          detuneLeft*1.5f),
-                                              timeInSeconds);
-                buffer[right] += oscSquare (keyToPitch (note.noteId,
-                                                        detuneRight*1.5f),
-                                            timeInSeconds);
-
-                buffer[left]  += oscSawtooth (keyToPitch (note.noteId,
-                                                          detuneLeft*3.f),
-                                              timeInSeconds);
-                buffer[right] += oscSquare (keyToPitch (note.noteId,
-                                                        detuneRight*3.f),
-                                            timeInSeconds);
-
-                buffer[left]  += oscSawtooth (keyToPitch (note.noteId,
-                                                          detuneLeft*4.5f),
-                                              timeInSeconds);
-                buffer[right] += oscSquare (keyToPitch (note.noteId,
-                                                        detuneRight*4.5f),
-                                            timeInSeconds);
-                break;
-            }
-            case 4 : {
-                buffer[left] = oscNoise();
-                buffer[right] = oscNoise();
-                break;
-            }
-
-            default :
-            break;
-        }
-
-        buffer[left] *= level;
-        buffer[right] *= level;
-
-        if (makeDirty) {
-            buffer[left] += .125*oscNoise();
-            buffer[right] += .125*oscNoise();
-        }
+    while (true) {
+        midi.padColorCycle();
     }
 }
 
-static bool makeDirty = false;
-static short instrument = 0;
-static short numBuffersPerSecond = 0;
-
-// assumes power-of-two number of samples, no zero-padding, no checks
-void computeFFT (vector<complex<float>>::iterator begin,
-                 vector<complex<float>>::iterator end)
+void Application::readMidiKeys(const Midi& midi, RingBuffer<MidiEvent>& midiEvents)
 {
-    auto numSamples = distance (begin, end);
-
-    if (numSamples < 2) {
-        return;
-    } else {
-        // 'sort' even-indexed samples into the front half and odd ones in the
-        // back half
-        stable_partition (begin, end, [&begin] (auto& a) {
-            return distance (&*begin, &a) % 2 == 0;
-        });
-
-        // recursion step
-        computeFFT (begin, begin + numSamples/2); // even
-        computeFFT (begin + numSamples/2, end); // odd
-
-        // do the actual computation time->frequency domain
-        for (decltype (numSamples) k = 0; k < numSamples/2; ++k) {
-            auto even = *(begin + k);
-            auto odd  = *(begin + k + numSamples/2);
-            auto w = exp (complex<float>(.0f, -2.f*M_PI*k/numSamples))*odd;
-
-            *(begin + k) = even + w;
-            *(begin + k + numSamples/2) = even - w;
+    while (true) {
+        MidiEvent event = midi.read();
+        if (event.type != MessageType::None) {
+            midiEvents.push (event);
         }
     }
 }
 
-void computeFastFourierTransform (vector<float>& sampleBufferForDrawing,
-                                  vector<float>& fftBufferForDrawing,
-                                  float fromFrequency,
-                                  float toFrequency,
-                                  size_t frequencyBins,
-                                  size_t samples,
-                                  size_t sampleRate,
-                                  size_t channels)
+static void fillSampleBuffer (void* userdata, Uint8* stream, int lengthInBytes)
 {
-    size_t sampleBufferSize = sampleBufferForDrawing.size();
-    float reciprocal = 5.f/static_cast<float> (samples);
-
-    vector<complex<float>> leftChannel (sampleBufferSize/2, .0f);
-    for (size_t i = 0; i < sampleBufferSize; i += 2) {
-        leftChannel[i/2] = sampleBufferForDrawing[i];
-    }
-
-    computeFFT (leftChannel.begin(), leftChannel.end());
-
-    for (size_t bin = 0; bin < frequencyBins; ++bin) {
-        size_t left = 2*bin;
-        fftBufferForDrawing[left] = reciprocal*sqrt (leftChannel[bin].real() *
-                                                     leftChannel[bin].real() +
-                                                     leftChannel[bin].imag() *
-                                                     leftChannel[bin].imag());
-    }
-}
-
-void fillSampleBuffer (void* userdata, Uint8* stream, int lengthInBytes)
-{
-    std::lock_guard<std::mutex> guard(synthDataMutex);
-
-    // auto start = std::chrono::steady_clock::now();
-
     SynthData* synthData = reinterpret_cast<SynthData*> (userdata);
-    float secondPerTick = 1.f/static_cast<float> (synthData->sampleRate);
-    float volume = synthData->volume;
-    SDL_memset (stream, 0, lengthInBytes);
-    int sizePerSample = static_cast<int> (sizeof (float));
-    shared_ptr<vector<vector<float>>> voiceBuffers = synthData->voiceBuffers;
-    shared_ptr<vector<float>> sampleBufferForDrawing = synthData->sampleBufferForDrawing;
-    shared_ptr<vector<float>> fftBufferForDrawing = synthData->fftBufferForDrawing;
-    float* sampleBuffer = reinterpret_cast<float*> (stream);
-
-    float detuneLeft = 20.f*(.5f + .5f*sin (w (.025f)));
-    float detuneRight = 10.f*(.5f + .5f*sin (w (.025f)));
-    std::vector<std::thread> threads;
-    for (auto& note : *synthData->notes) {
-        threads.push_back (std::thread (fillVoiceBuffer,
-                                        instrument,
-                                        std::ref (voiceBuffers->at(note.voice)),
-                                        std::ref (note),
-                                        synthData->ticks,
-                                        secondPerTick,
-                                        detuneLeft,
-                                        detuneRight,
-                                        makeDirty));
-    }
-
-    for (auto& t : threads) {
-        t.join();
-    }
-
-    for (int i = 0; i < lengthInBytes/sizePerSample; i += 2) {
-        int left = i;
-        int right = i + 1;
-        float sumLeft = .0f;
-        float sumRight = .0f;
-
-        for (const auto& note : *synthData->notes) {
-            sumLeft += voiceBuffers->at(note.voice)[left];
-            sumRight += voiceBuffers->at(note.voice)[right];
-        }
-
-        sampleBuffer[left] = volume*sumLeft;
-        sampleBuffer[right] = volume*sumRight;
-
-        (*sampleBufferForDrawing)[left] = sampleBuffer[left];
-        (*sampleBufferForDrawing)[right] = sampleBuffer[right];
-    }
+    size_t samples = lengthInBytes/static_cast<int> (sizeof (float));
 
-    float fromFrequency = .0f;
-    float toFrequency = 22'500.f;
-    if (synthData->doFFT) {
-        computeFastFourierTransform ((*sampleBufferForDrawing),
-                                     (*fftBufferForDrawing),
-                                     fromFrequency,
-                                     toFrequency,
-                                     synthData->frequencyBins,
-                                     synthData->samples,
-                                     synthData->sampleRate,
-                                     synthData->channels);
-    }
-
-    synthData->ticks += ((lengthInBytes/sizePerSample - 1) / 2) + 1;
-    ++numBuffersPerSecond;
-
-    // auto end = std::chrono::steady_clock::now();
-    // auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    // std::cout << "ms: " << duration.count() << '\n';
+    SDL_memset (stream, 0, lengthInBytes);
+    renderSynth (*synthData,
+                 reinterpret_cast<float*> (stream),
+                 samples/synthData->channels,
+                 secondsNow ());
 }
 
-Application::Application (size_t width, size_t height, const string& midiPort)
+Application::Application (size_t width,
+                          size_t height,
+                          const string& midiPort,
+                          const string& smfFile)
     : _initialized {false}
     , _window {nullptr}
     , _running {false}
-    , _synth {Synth(_maxVoices)}
-    , _sampleBufferForDrawing (_sampleBufferSize*_channels)
-    , _fftBufferForDrawing (_frequencyBins*_channels)
+    , _synth (_maxVoices, _sampleRate)
 	, _midi {midiPort}
 {
-    initialize ();
+    // time of each phase of the start-up
+    auto phase = std::chrono::steady_clock::now ();
+    auto lap = [&phase] () {
+        auto now = std::chrono::steady_clock::now ();
+        float milliseconds = std::chrono::duration<float, std::milli> (now - phase).count ();
+        phase = now;
+        return milliseconds;
+    };
 
-    _voiceBuffers.reserve(_maxVoices);
-    for (size_t voice = 0; voice < _maxVoices; ++voice) {
-        _voiceBuffers.push_back(std::vector<float> (_sampleBufferSize*_channels));
-        std::fill_n (_voiceBuffers[voice].begin(),
-                     _sampleBufferSize*_channels,
-                     .0f);
-    }
+    initialize ();
+    float initializeTime = lap ();
 
     SDL_GL_SetAttribute (SDL_GL_RED_SIZE, 8);
     SDL_GL_SetAttribute (SDL_GL_GREEN_SIZE, 8);
@@ -486,6 +166,7 @@ Application::Application (size_t width, size_t height, const string& midiPort)
         cout << "window creation failed: " << SDL_GetError () << newline;
         return;
     }
+    float windowTime = lap ();
 
     int count = SDL_GetNumAudioDevices (0);
     for (int i = 0; i < count; ++i) {
@@ -497,17 +178,10 @@ Application::Application (size_t width, size_t height, const string& midiPort)
     SDL_AudioSpec want;
     SDL_AudioSpec have;
 
-    _synthData.sampleRate = _sampleRate;
-    _synthData.channels = _channels;
-    _synthData.samples = _sampleBufferSize;
-    _synthData.frequencyBins = _frequencyBins;
-    _synthData.doFFT = false;
-    _synthData.ticks = 0;
-    _synthData.volume = .1f;
-    _synthData.notes = _synth.notes();
-    _synthData.sampleBufferForDrawing = make_shared<vector<float>>(_sampleBufferForDrawing);
-    _synthData.fftBufferForDrawing = make_shared<vector<float>>(_fftBufferForDrawing);
-    _synthData.voiceBuffers = make_shared<vector<vector<float>>>(_voiceBuffers);
+    _synthData.volume = _volume;
+    _synthData.makeDirty = _makeDirty;
+    _synthData.commands = &_commands;
+    _synthData.blockTime = secondsNow ();
 
     SDL_zero (want);
     want.freq = _sampleRate;
@@ -531,6 +205,7 @@ Application::Application (size_t width, size_t height, const string& midiPort)
         }
         SDL_PauseAudioDevice (_audioDevice, _mute);
     }
+    float audioTime = lap ();
 
     SDL_ClearError (); 
     _context = SDL_GL_CreateContext (_window);
@@ -541,13 +216,65 @@ Application::Application (size_t width, size_t height, const string& midiPort)
         _initialized = false;
         return;
     }
+    float contextTime = lap ();
+
+    // a column of the scope per pixel
+    _scopeColumns = std::min<size_t> (width, ANALYZER_SCOPE_COLUMNS);
+    _synthData.analyzer->setScope (_scopeColumns, _scopeSpan, _scopeTrigger);
 
     _gl.reset(new OpenGL(width, height));
-    _gl->init(_sampleBufferSize*_channels, _frequencyBins*_channels);
+    _gl->init(_scopeColumns, _frequencyBins*_channels);
+    _spectrogramRow.resize (_frequencyBins*_channels, .0f);
+    _synthData.analyzer->start ();
+    float rendererTime = lap ();
+
+    cout << "start-up: SDL and synth " << initializeTime
+         << " ms, window " << windowTime
+         << " ms, audio " << audioTime
+         << " ms, GL-context " << contextTime
+         << " ms, renderer " << rendererTime << " ms" << newline;
+
+    if (!smfFile.empty () && _smf.open (smfFile)) {
+        _playing = true;
+        _smfPlayer = std::thread (playSmf,
+                                  std::ref (_smf),
+                                  std::ref (_smfEvents),
+                                  std::ref (_playing));
+    }
 }
 
 Application::~Application ()
 {
+    _playing = false;
+    if (_smfPlayer.joinable ()) {
+        _smfPlayer.join ();
+    }
+
+    if (_midiEvents.overflows () > 0) {
+        cout << "MIDI-events dropped: " << _midiEvents.overflows ()
+             << " (capacity " << _midiEvents.capacity () << ")" << newline;
+    }
+    if (_delayedCommands > 0) {
+        cout << "synth-commands delayed: " << _delayedCommands
+             << " (capacity " << _commands.capacity () << ")" << newline;
+    }
+    if (_synthData.droppedNoteOns > 0 || _synthData.earlyNoteOffs > 0) {
+        cout << "note-ons dropped: " << _synthData.droppedNoteOns
+             << ", note-offs applied early: " << _synthData.earlyNoteOffs
+             << " (capacity " << MAX_PENDING_EVENTS << ")" << newline;
+    }
+
+    if (_synthData.monitor) {
+        _synthData.monitor->report ();
+    }
+    if (_gl) {
+        _gl->dump (cout);
+    }
+
+    cout << "voices stolen: " << _synth.steals ()
+         << ", retriggered: " << _synth.retriggers ()
+         << ", cut: " << _synth.hardCuts () << newline;
+
 	if (_midi.initialized()) {
 		for (unsigned char pad = 0; pad < 16; ++pad) {
 			_midi.setPadColor (pad, PadColor::Black);
@@ -564,45 +291,32 @@ void Application::handle_events ()
 {
     SDL_Event event;
 
+    flushCommands ();
+
     auto addNote = [=](SDL_Keycode key, NoteId noteId) {
         if (!_pressedKeys[key]) {
-            _synth.addNote (noteId);
+            scheduleNote (MessageType::NoteOn, noteId, 1.f, secondsNow ());
             _pressedKeys[key] = true;
         }
     };
 
     auto removeNote = [=](SDL_Keycode key, NoteId noteId) {
-        _synth.removeNote (noteId);
+        scheduleNote (MessageType::NoteOff, noteId, 1.f, secondsNow ());
         _pressedKeys[key] = false;
     };
 
-	if (_midi.initialized()) {
-        std::lock_guard<std::mutex> guard(midiMessageQueueMutex);
-        if (_midiMessageQueue.size() > 0) {
-            auto message = _midiMessageQueue.front();
-
-            MessageType type = std::get<0>(message);
-            char noteId = std::get<1> (message);
-            char velocity = std::get<2> (message);
-            float timeStamp = std::get<3> (message);
-
-            _midiMessageQueue.pop();
-
-            if (type == MessageType::NoteOff) {
-                _synth.removeNoteMidi (static_cast<NoteId>(noteId - 20),
-                                       static_cast<float>(velocity)/128.f,
-                                       timeStamp);
-            }
-
-            if (type == MessageType::NoteOn) {
-                _synth.addNoteMidi (static_cast<NoteId>(noteId - 20),
-                                    static_cast<float>(velocity)/128.f,
-                                    timeStamp);
-            }
+    // drain everything that arrived since the last frame, not just one
+    MidiEvent midiEvent;
+    while (_midiEvents.pop (midiEvent) || _smfEvents.pop (midiEvent)) {
+        if (midiEvent.type == MessageType::NoteOff ||
+            midiEvent.type == MessageType::NoteOn) {
+            scheduleNote (midiEvent.type,
+                          static_cast<NoteId>(midiEvent.noteId - 20),
+                          static_cast<float>(midiEvent.velocity)/128.f,
+                          midiEvent.timeStamp);
         }
     }
 
-    std::lock_guard<std::mutex> guard(synthDataMutex);
     while (SDL_PollEvent (&event)) {
         switch (event.type) {
         case SDL_KEYUP:
@@ -629,25 +343,66 @@ void Application::handle_events ()
                     break;
                 }
 
-                case SDLK_F1: instrument = 0; break;
-                case SDLK_F2: instrument = 1; break;
-                case SDLK_F3: instrument = 2; break;
-                case SDLK_F4: instrument = 3; break;
-                case SDLK_F5: instrument = 4; break;
-                case SDLK_F6: makeDirty = !makeDirty; break;
-                case SDLK_F7: _synthData.doFFT = !_synthData.doFFT; break;
-                case SDLK_PLUS : if (_synthData.volume <= .95f) {
-                                     _synthData.volume += .05f;
-                                     cout << "volume " << _synthData.volume << '\n';
+                case SDLK_F1: sendCommand (SetInstrument, 0); break;
+                case SDLK_F2: sendCommand (SetInstrument, 1); break;
+                case SDLK_F3: sendCommand (SetInstrument, 2); break;
+                case SDLK_F4: sendCommand (SetInstrument, 3); break;
+                case SDLK_F5: sendCommand (SetInstrument, 4); break;
+                case SDLK_F6: _makeDirty = !_makeDirty;
+                              sendCommand (SetDirty, _makeDirty);
+                              break;
+                case SDLK_F7: _displayMode = (_displayMode + 1) % DISPLAY_MODES;
+                              _synthData.analyzer->setSpectrum (_displayMode != ScopeDisplay);
+                              cout << "display " << displayModeNames[_displayMode] << '\n';
+                              break;
+                case SDLK_F8: sendCommand (SetInstrument, 5); break;
+                case SDLK_F10: sendCommand (SetInstrument, 6); break;
+                case SDLK_F9: _fmAlgorithm = (_fmAlgorithm + 1) % FM_ALGORITHMS;
+                              sendCommand (SetFmAlgorithm, _fmAlgorithm);
+                              cout << "FM-algorithm " << _fmAlgorithm + 1 << '\n';
+                              break;
+                case SDLK_F12: _synthData.monitor->dump (cout);
+                               _gl->dump (cout);
+                               break;
+                case SDLK_F11: _stealPolicy = (_stealPolicy + 1) % STEAL_POLICIES;
+                               sendCommand (SetStealPolicy, _stealPolicy);
+                               cout << "voice-stealing " << stealPolicyNames[_stealPolicy] << '\n';
+                               break;
+                case SDLK_PLUS : if (_volume <= .95f) {
+                                     _volume += .05f;
+                                     sendCommand (SetVolume, _volume);
+                                     cout << "volume " << _volume << '\n';
                                  }
                                  break;
-                case SDLK_MINUS : if (_synthData.volume >= .05f) {
-                                     _synthData.volume -= .05f;
-                                     cout << "volume " << _synthData.volume << '\n';
+                case SDLK_MINUS : if (_volume >= .05f) {
+                                     _volume -= .05f;
+                                     sendCommand (SetVolume, _volume);
+                                     cout << "volume " << _volume << '\n';
                                  }
                                  break;
+                case SDLK_w: _spectrumWindow = (_spectrumWindow + 1) % SPECTRUM_WINDOWS;
+                             _synthData.analyzer->setWindow (static_cast<SpectrumWindow> (_spectrumWindow));
+                             cout << "spectrum-window " << spectrumWindowNames[_spectrumWindow] << '\n';
+                             break;
+                case SDLK_UP: if (2*_scopeSpan <= _synthData.analyzer->scopeHistory ()) {
+                                  _scopeSpan *= 2;
+                                  _synthData.analyzer->setScope (_scopeColumns, _scopeSpan, _scopeTrigger);
+                                  cout << "scope " << 1e3f*_scopeSpan/_sampleRate << " ms" << '\n';
+                              }
+                              break;
+                case SDLK_DOWN: if (_scopeSpan/2 >= SCOPE_MIN_SPAN) {
+                                    _scopeSpan /= 2;
+                                    _synthData.analyzer->setScope (_scopeColumns, _scopeSpan, _scopeTrigger);
+                                    cout << "scope " << 1e3f*_scopeSpan/_sampleRate << " ms" << '\n';
+                                }
+                                break;
+                case SDLK_t: _scopeTrigger = !_scopeTrigger;
+                             _synthData.analyzer->setScope (_scopeColumns, _scopeSpan, _scopeTrigger);
+                             cout << "scope-trigger " << (_scopeTrigger ? "on" : "off") << '\n';
+                             break;
                 case SDLK_SPACE: {
                     _mute = !_mute;
+                    _synthData.monitor->resume ();
                     SDL_PauseAudioDevice (_audioDevice, _mute);
                     break;
                 }
@@ -679,160 +434,76 @@ void Application::handle_events ()
     }
 }
 
-void Application::run ()
+void Application::scheduleNote (MessageType type,
+                                NoteId noteId,
+                                float velocity,
+                                double timeStamp)
 {
-    if (!_initialized)
-        return;
-
-    _running = true;
-
-    while (_running) {
-        handle_events ();
-        update ();
-         _synth.clearNotes ();
-    }
+    SynthCommand command;
+    command.type = type == MessageType::NoteOn ? NoteOnCommand : NoteOffCommand;
+    command.noteId = noteId;
+    command.value = velocity;
+    command.timeStamp = timeStamp;
+    pushCommand (command);
 }
 
-void Application::update ()
+void Application::sendCommand (CommandType type, float value)
 {
-    if (!_initialized)
-        return;
-
-    _gl->draw (*_synthData.sampleBufferForDrawing,
-               *_synthData.fftBufferForDrawing,
-               _synthData.doFFT);
-    SDL_GL_SwapWindow(_window);
+    SynthCommand command;
+    command.type = type;
+    command.noteId = 0;
+    command.value = value;
+    command.timeStamp = secondsNow ();
+    pushCommand (command);
 }
 
-Synth::Synth (unsigned int maxVoices)
-    : _notes {std::make_shared<Notes>()}
-    , _maxVoices {maxVoices}
+// A full ring never loses a command, it waits behind the ones already
+// waiting. It keeps its time-stamp and is applied late rather than never.
+void Application::pushCommand (const SynthCommand& command)
 {
-    for (int voice = 0; voice < _maxVoices; ++voice) {
-        _voiceAllocation.push_back(false);
+    if (!_unsentCommands.empty () || !_commands.push (command)) {
+        _unsentCommands.push_back (command);
+        ++_delayedCommands;
     }
 }
 
-void Synth::addNote (NoteId noteId)
+void Application::flushCommands ()
 {
-    if (_notes->size() < _maxVoices) {
-        auto result = find_if (_notes->begin(),
-                               _notes->end(),
-                               [noteId] (Note note) {
-                                   return note.noteId == noteId;
-                               });
-        if (result != _notes->end()) {
-            if ((*result).amplitudeADSR.noteReleased) {
-                (*result).amplitudeADSR.noteOn (elapsedSeconds());
-                (*result).amplitudeADSR.noteOff (.0f);
-                (*result).filterADSR.noteOn (elapsedSeconds());
-                (*result).filterADSR.noteOff (.0f);
-            }
-        } else {
-            Note note;
-            note.noteId = noteId;
-            note.amplitudeADSR.noteOn (elapsedSeconds());
-            note.filterADSR.noteOn (elapsedSeconds());
-            note.filterADSR.attackTime = .5f;
-            note.filterADSR.decayTime = .1f;
-            note.filterADSR.sustainLevel = .7f;
-            note.filterADSR.releaseTime = 1.f;
-            note.voice = allocVoice();
-            _notes->emplace_back (note);
-        }
+    size_t sent = 0;
+    while (sent < _unsentCommands.size () && _commands.push (_unsentCommands[sent])) {
+        ++sent;
     }
+    _unsentCommands.erase (_unsentCommands.begin (), _unsentCommands.begin () + sent);
 }
 
-void Synth::removeNote (NoteId noteId)
+void Application::run ()
 {
-    auto result = find_if (_notes->begin(),
-                           _notes->end(),
-                           [noteId] (Note note) {
-                               return note.noteId == noteId;
-                           });
-
-    if (result != _notes->end()) {
-        (*result).amplitudeADSR.noteOff (elapsedSeconds());
-        (*result).filterADSR.noteOff (elapsedSeconds());
-    }
-}
+    if (!_initialized)
+        return;
 
-void Synth::addNoteMidi(NoteId noteId, float velocity, float timeStamp)
-{
-    if (_notes->size() < _maxVoices) {
-        auto result = find_if (_notes->begin(),
-                               _notes->end(),
-                               [noteId] (Note note) {
-                                   return note.noteId == noteId;
-                               });
-        if (result != _notes->end()) {
-            if ((*result).amplitudeADSR.noteReleased) {
-                (*result).amplitudeADSR.noteOn (timeStamp);
-                (*result).filterADSR.noteOn (timeStamp);
-                (*result).velocity = velocity;
-                (*result).amplitudeADSR.noteOff (.0f);
-                (*result).filterADSR.noteOff (.0f);
-            }
-        } else {
-            Note note;
-            note.noteId = noteId;
-            note.amplitudeADSR.noteOn (timeStamp);
-            note.filterADSR.noteOn (timeStamp);
-            note.filterADSR.attackTime = .5f;
-            note.filterADSR.decayTime = .1f;
-            note.filterADSR.sustainLevel = .7f;
-            note.filterADSR.releaseTime = 1.f;
-            note.velocity = velocity;
-            note.voice = allocVoice();
-            _notes->emplace_back (note);
-        }
-    }
-}
+    _running = true;
 
-void Synth::removeNoteMidi(NoteId noteId, float velocity, float timeStamp)
-{
-    auto result = find_if (_notes->begin(),
-                           _notes->end(),
-                           [noteId] (Note note) {
-                               return note.noteId == noteId;
-                           });
-
-    if (result != _notes->end()) {
-        (*result).amplitudeADSR.noteOff (timeStamp);
-        (*result).filterADSR.noteOff (timeStamp);
+    while (_running) {
+        handle_events ();
+        update ();
     }
 }
 
-void Synth::clearNotes ()
-{
-    std::lock_guard<std::mutex> guard(synthDataMutex);
-    _notes->remove_if([this](Note& note){
-        bool flag = note.amplitudeADSR.level(elapsedSeconds()) < .0001f;
-        if (flag) {
-            freeVoice(note.voice);
-        }
-        return flag;
-    });
-}
-
-std::shared_ptr<Notes> Synth::notes()
+void Application::update ()
 {
-    return _notes;
-}
+    if (!_initialized)
+        return;
 
-int Synth::allocVoice()
-{
-    auto result = find (_voiceAllocation.begin(), _voiceAllocation.end(), false);
-    if (result != _voiceAllocation.end()) {
-        int index = std::distance(_voiceAllocation.begin(), result);
-        _voiceAllocation[index] = true;
-        return index;
-    } else {
-        return -1;
+    // every window analysed since the last frame, taken even when not shown
+    // so the spectrogram does not start on stale ones
+    while (_synthData.analyzer->spectrogramRow (_spectrogramRow)) {
+        if (_displayMode == SpectrogramDisplay) {
+            _gl->addSpectrogramRow (_spectrogramRow);
+        }
     }
-}
 
-void Synth::freeVoice(int voice)
-{
-    _voiceAllocation[voice] = false;
+    _gl->draw (_synthData.analyzer->scope (),
+               _synthData.analyzer->spectrum (),
+               static_cast<DisplayMode> (_displayMode));
+    SDL_GL_SwapWindow(_window);
 }
@@ -0,0 +1,254 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "analyzer.h"
+#include "envelope.h"
+#include "filters.h"
+#include "kernels.h"
+#include "synth.h"
+
+using namespace std;
+using namespace std::chrono;
+
+#define newline '\n'
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_FRAMES 1024
+#define BENCH_TRIALS 5
+// a trial repeats its body at least this long
+#define BENCH_MIN_SECONDS .05
+#define BENCH_MAX_VOICES 256
+
+// keeps the compiler from dropping the work of a benchmark
+static volatile float sink = .0f;
+
+// Best time over all trials of body, which processes samples per call. The
+// number of calls per trial is doubled until a trial lasts long enough to
+// rule out the resolution of the clock.
+template <typename Body>
+static double nsPerSample (size_t samples, Body body)
+{
+    body ();
+
+    size_t calls = 1;
+    while (true) {
+        auto start = steady_clock::now ();
+        for (size_t call = 0; call < calls; ++call) {
+            body ();
+        }
+        if (duration<double> (steady_clock::now () - start).count () >= BENCH_MIN_SECONDS) {
+            break;
+        }
+        calls *= 2;
+    }
+
+    double best = 1e300;
+    for (int trial = 0; trial < BENCH_TRIALS; ++trial) {
+        auto start = steady_clock::now ();
+        for (size_t call = 0; call < calls; ++call) {
+            body ();
+        }
+        best = min (best, duration<double> (steady_clock::now () - start).count ());
+    }
+
+    return best*1e9/static_cast<double> (calls*samples);
+}
+
+static void report (const string& benchmark, const string& variant, double ns)
+{
+    cout << benchmark << ',' << variant << ','
+         << fixed << setprecision (3) << ns << newline;
+}
+
+static void benchVoices (SynthData& synthData, Synth& synth)
+{
+    const char* instruments[] = {"sine", "square", "sawtooth", "combo", "noise", "fm"};
+    vector<float> buffer (2*BENCH_FRAMES);
+
+    synth.addNoteMidi (40, 1.f);
+    Note& note = synth.activeNote (0);
+
+    for (int instrument = 0; instrument < 6; ++instrument) {
+        double ns = nsPerSample (BENCH_FRAMES, [&] {
+            fillVoiceBuffer (instrument,
+                             buffer.data (),
+                             BENCH_FRAMES,
+                             note,
+                             synthData,
+                             1.f/BENCH_SAMPLE_RATE,
+                             10.f,
+                             5.f,
+                             false);
+            sink = buffer[0];
+        });
+        report ("fillVoiceBuffer", instruments[instrument], ns);
+    }
+
+    synth.removeNoteMidi (40, 1.f);
+}
+
+static void benchOscSine ()
+{
+    for (int harmonics : {1, 32, 64}) {
+        double ns = nsPerSample (BENCH_FRAMES, [harmonics] {
+            float sum = .0f;
+            for (size_t i = 0; i < BENCH_FRAMES; ++i) {
+                sum += oscSine (static_cast<float> (i)/BENCH_FRAMES, harmonics);
+            }
+            sink = sum;
+        });
+        report ("oscSine", to_string (harmonics), ns);
+    }
+}
+
+static void benchEnvelope ()
+{
+    Envelope envelope;
+    vector<float> gain (BENCH_FRAMES);
+    size_t blocks = 0;
+
+    // toggling the gate now and then passes through all the stages
+    auto gate = [&envelope, &blocks] {
+        if (++blocks % 32 == 0) {
+            if (envelope.noteReleased || !envelope.noteActive) {
+                envelope.noteOn ();
+            } else {
+                envelope.noteOff ();
+            }
+        }
+    };
+
+    envelope.noteOn ();
+    double ns = nsPerSample (BENCH_FRAMES, [&] {
+        gate ();
+        float sum = .0f;
+        for (size_t i = 0; i < BENCH_FRAMES; ++i) {
+            sum += envelope.next ();
+        }
+        sink = sum;
+    });
+    report ("Envelope", "next", ns);
+
+    ns = nsPerSample (BENCH_FRAMES, [&] {
+        gate ();
+        envelope.process (gain.data (), BENCH_FRAMES);
+        sink = gain[0];
+    });
+    report ("Envelope", "process", ns);
+}
+
+static void benchFilters ()
+{
+    vector<float> input (BENCH_FRAMES);
+    for (auto& sample : input) {
+        sample = static_cast<float> (random ())/RAND_MAX - .5f;
+    }
+
+    for (TYPE type : {TYPE::LOWPASS, TYPE::HIGHPASS}) {
+        for (ORDER order : {ORDER::OD1, ORDER::OD2, ORDER::OD3, ORDER::OD4}) {
+            Filter filter (1000.f, 1.f/BENCH_SAMPLE_RATE, order, type);
+            double ns = nsPerSample (BENCH_FRAMES, [&] {
+                float sum = .0f;
+                for (float sample : input) {
+                    sum += filter.filterIn (sample);
+                }
+                sink = sum;
+            });
+            report ("Filter::filterIn",
+                    string (type == TYPE::LOWPASS ? "lowpass-" : "highpass-")
+                    + to_string (static_cast<int> (order) + 1),
+                    ns);
+        }
+    }
+}
+
+static void benchFFT ()
+{
+    for (size_t samples : {256, 512, 1024, 2048, 4096}) {
+        vector<float> sampleBuffer (2*samples);
+        vector<float> fftBuffer (samples);
+        SpectrumPlan plan (samples, .0f, 22'500.f, samples/2, BENCH_SAMPLE_RATE);
+        for (auto& sample : sampleBuffer) {
+            sample = static_cast<float> (random ())/RAND_MAX - .5f;
+        }
+
+        double ns = nsPerSample (samples, [&] {
+            computeFastFourierTransform (plan, sampleBuffer, fftBuffer, 2);
+            sink = fftBuffer[1];
+        });
+        report ("computeFastFourierTransform", to_string (samples), ns);
+    }
+}
+
+static void benchMix ()
+{
+    vector<vector<float>> voiceBuffers (BENCH_MAX_VOICES,
+                                        vector<float> (2*BENCH_FRAMES, .1f));
+    vector<float> out (2*BENCH_FRAMES);
+
+    for (size_t voices = 1; voices <= BENCH_MAX_VOICES; voices *= 2) {
+        double ns = nsPerSample (BENCH_FRAMES, [&] {
+            std::fill (out.begin (), out.end (), .0f);
+            for (size_t voice = 0; voice < voices; ++voice) {
+                kernelAccumulate (out.data (), voiceBuffers[voice].data (), 2*BENCH_FRAMES);
+            }
+            sink = out[0];
+        });
+        report ("mix", to_string (voices), ns);
+    }
+}
+
+// the whole block as the audio-callback renders it, one note per voice
+static void benchRender (SynthData& synthData, Synth& synth)
+{
+    vector<float> block (2*BENCH_FRAMES);
+
+    // the notes of the benchmarks before have to fade out first
+    while (synth.activeNotes () > 0) {
+        renderSynth (synthData, block.data (), BENCH_FRAMES, .0);
+    }
+
+    for (size_t voices = 1; voices <= MAX_NOTE_IDS; voices *= 2) {
+        for (size_t note = synth.activeNotes (); note < voices; ++note) {
+            synth.addNoteMidi (static_cast<NoteId> (note) - NOTE_ID_OFFSET, 1.f);
+        }
+
+        double ns = nsPerSample (BENCH_FRAMES, [&] {
+            std::fill (block.begin (), block.end (), .0f);
+            renderSynth (synthData, block.data (), BENCH_FRAMES, .0);
+            sink = block[0];
+        });
+        report ("renderSynth", to_string (voices), ns);
+    }
+}
+
+// Measures the DSP hot paths without window, audio-device or anyone
+// playing. Prints one line of "benchmark,variant,ns_per_sample" each, a
+// sample being one frame of the stereo stream for all but the filters and
+// envelopes.
+int main ()
+{
+    Synth synth (BENCH_MAX_VOICES, BENCH_SAMPLE_RATE);
+    SynthData synthData;
+    setupSynthData (synthData,
+                    synth,
+                    BENCH_SAMPLE_RATE,
+                    2,
+                    BENCH_FRAMES,
+                    BENCH_FRAMES/2);
+
+    cout << "benchmark,variant,ns_per_sample" << newline;
+
+    benchVoices (synthData, synth);
+    benchOscSine ();
+    benchEnvelope ();
+    benchFilters ();
+    benchFFT ();
+    benchMix ();
+    benchRender (synthData, synth);
+
+    return 0;
+}
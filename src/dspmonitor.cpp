@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "dspmonitor.h"
+
+using namespace std::chrono;
+
+#define newline '\n'
+
+DspMonitor::DspMonitor (size_t voices)
+    : _voiceBlock (voices, .0f)
+    , _voiceMicroseconds (voices)
+{
+    for (auto& bucket : _histogram) {
+        bucket.store (0, std::memory_order_relaxed);
+    }
+    for (auto& voice : _voiceMicroseconds) {
+        voice.store (.0f, std::memory_order_relaxed);
+    }
+}
+
+void DspMonitor::beginBlock ()
+{
+    _blockStart = Clock::now ();
+
+    bool resumed = _resumed.load (std::memory_order_relaxed) &&
+                   _resumed.exchange (false, std::memory_order_relaxed);
+    if (_blocks.load (std::memory_order_relaxed) > 0 && !resumed) {
+        double gap = duration<double> (_blockStart - _previousStart).count ();
+        if (gap > DSP_XRUN_FACTOR*_previousDeadline) {
+            _xruns.fetch_add (1, std::memory_order_relaxed);
+        }
+    }
+    _previousStart = _blockStart;
+}
+
+void DspMonitor::resume ()
+{
+    _resumed.store (true, std::memory_order_relaxed);
+}
+
+void DspMonitor::endBlock (double deadlineSeconds)
+{
+    double seconds = duration<double> (Clock::now () - _blockStart).count ();
+    float load = static_cast<float> (100.*seconds/deadlineSeconds);
+    _previousDeadline = deadlineSeconds;
+
+    size_t bucket = std::min<size_t> (static_cast<size_t> (load),
+                                      DSP_HISTOGRAM_BUCKETS - 1);
+    _histogram[bucket].fetch_add (1, std::memory_order_relaxed);
+
+    if (seconds > deadlineSeconds) {
+        _misses.fetch_add (1, std::memory_order_relaxed);
+    }
+    if (load > _maxLoad.load (std::memory_order_relaxed)) {
+        _maxLoad.store (load, std::memory_order_relaxed);
+    }
+    _load.store (load, std::memory_order_relaxed);
+    _deadlineMilliseconds.store (static_cast<float> (1e3*deadlineSeconds),
+                                 std::memory_order_relaxed);
+    // single writer, so load and store do not need to be one operation
+    _loadSum.store (_loadSum.load (std::memory_order_relaxed) + load,
+                    std::memory_order_relaxed);
+
+    double voiceSum = .0;
+    uint64_t voiceBlocks = 0;
+    for (size_t voice = 0; voice < _voiceBlock.size (); ++voice) {
+        if (_voiceBlock[voice] > .0f) {
+            _voiceMicroseconds[voice].store (_voiceBlock[voice], std::memory_order_relaxed);
+            voiceSum += _voiceBlock[voice];
+            ++voiceBlocks;
+            _voiceBlock[voice] = .0f;
+        }
+    }
+    _voiceMicrosecondsSum.store (_voiceMicrosecondsSum.load (std::memory_order_relaxed) + voiceSum,
+                                 std::memory_order_relaxed);
+    _voiceBlocks.fetch_add (voiceBlocks, std::memory_order_relaxed);
+
+    _blocks.fetch_add (1, std::memory_order_relaxed);
+}
+
+void DspMonitor::addVoiceTime (int voice, float microseconds)
+{
+    // a voice is rendered by one job at a time, jobs of a block are separated
+    // by the barrier of the worker-pool
+    if (voice >= 0 && static_cast<size_t> (voice) < _voiceBlock.size ()) {
+        _voiceBlock[voice] += microseconds;
+    }
+}
+
+DspSnapshot DspMonitor::snapshot () const
+{
+    DspSnapshot snapshot;
+
+    snapshot.blocks = _blocks.load (std::memory_order_relaxed);
+    snapshot.misses = _misses.load (std::memory_order_relaxed);
+    snapshot.xruns = _xruns.load (std::memory_order_relaxed);
+    snapshot.deadlineMilliseconds = _deadlineMilliseconds.load (std::memory_order_relaxed);
+    snapshot.load = _load.load (std::memory_order_relaxed);
+    snapshot.maxLoad = _maxLoad.load (std::memory_order_relaxed);
+    if (snapshot.blocks > 0) {
+        snapshot.averageLoad = static_cast<float> (_loadSum.load (std::memory_order_relaxed)/snapshot.blocks);
+    }
+
+    uint64_t voiceBlocks = _voiceBlocks.load (std::memory_order_relaxed);
+    if (voiceBlocks > 0) {
+        snapshot.averageVoiceMicroseconds = static_cast<float> (_voiceMicrosecondsSum.load (std::memory_order_relaxed)/voiceBlocks);
+    }
+    for (auto& voice : _voiceMicroseconds) {
+        snapshot.voiceMicroseconds.push_back (voice.load (std::memory_order_relaxed));
+    }
+
+    // the histogram may have moved on while being read, so the percentiles
+    // refer to its own total
+    uint64_t counts[DSP_HISTOGRAM_BUCKETS];
+    uint64_t total = 0;
+    for (size_t bucket = 0; bucket < DSP_HISTOGRAM_BUCKETS; ++bucket) {
+        counts[bucket] = _histogram[bucket].load (std::memory_order_relaxed);
+        total += counts[bucket];
+    }
+
+    float* percentiles[] = {&snapshot.p50, &snapshot.p90, &snapshot.p99, &snapshot.p999};
+    double fractions[] = {.5, .9, .99, .999};
+    for (size_t p = 0; p < 4 && total > 0; ++p) {
+        uint64_t rank = static_cast<uint64_t> (fractions[p]*(total - 1));
+        uint64_t seen = 0;
+        size_t bucket = 0;
+        while (bucket < DSP_HISTOGRAM_BUCKETS - 1 && seen + counts[bucket] <= rank) {
+            seen += counts[bucket];
+            ++bucket;
+        }
+        // upper edge of the bucket, so they never come out too optimistic
+        *percentiles[p] = std::min (static_cast<float> (bucket + 1),
+                                    snapshot.maxLoad);
+    }
+
+    return snapshot;
+}
+
+void DspMonitor::dump (std::ostream& out) const
+{
+    DspSnapshot s = snapshot ();
+
+    // formatted aside, out keeps its own precision
+    std::ostringstream text;
+    text << std::fixed << std::setprecision (1);
+    text << "DSP-load of " << s.blocks << " blocks of "
+         << s.deadlineMilliseconds << " ms:" << newline;
+    text << "  load % last " << s.load
+         << ", average " << s.averageLoad
+         << ", p50 " << s.p50
+         << ", p90 " << s.p90
+         << ", p99 " << s.p99
+         << ", p99.9 " << s.p999
+         << ", max " << s.maxLoad << newline;
+    text << "  deadline-misses " << s.misses
+         << ", xruns " << s.xruns << newline;
+    text << "  per voice and block " << s.averageVoiceMicroseconds
+         << " us on average, last:";
+    for (float microseconds : s.voiceMicroseconds) {
+        text << ' ' << microseconds;
+    }
+    text << newline;
+    out << text.str ();
+}
+
+void DspMonitor::report () const
+{
+    const char* path = std::getenv (DSP_REPORT_VARIABLE);
+    if (!path) {
+        dump (std::cout);
+        return;
+    }
+
+    std::ofstream file (path);
+    if (!file) {
+        std::cout << "could not write the DSP-report to " << path << newline;
+        dump (std::cout);
+        return;
+    }
+    dump (file);
+}
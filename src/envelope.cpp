@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "envelope.h"
+
+// fraction of the distance to the end-level left over at the end of an
+// exponential segment (-60dB), which is then snapped to the end-level
+#define CURVE_RESIDUE .001f
+
+void Envelope::noteOn ()
+{
+    noteActive = true;
+    noteReleased = false;
+    enter (Attack);
+}
+
+void Envelope::noteOff ()
+{
+    if (_stage != Idle) {
+        noteReleased = true;
+        enter (Release);
+    }
+}
+
+float Envelope::level () const
+{
+    return _level;
+}
+
+float Envelope::next ()
+{
+    float current = _level;
+    advance (1);
+    return current;
+}
+
+void Envelope::process (float* gain, size_t frames)
+{
+    while (frames > 0) {
+        size_t count = frames < _remaining ? frames : _remaining;
+        float level = _level;
+
+        for (size_t i = 0; i < count; ++i) {
+            gain[i] = level;
+            level = level*_multiplier + _increment;
+        }
+
+        _level = level;
+        _remaining -= count;
+        gain += count;
+        frames -= count;
+
+        if (_remaining == 0) {
+            // a finished segment lands exactly on its end-level
+            _level = _target;
+            enter (static_cast<Stage> (_stage + 1));
+        }
+    }
+}
+
+void Envelope::advance (size_t frames)
+{
+    while (frames > 0) {
+        size_t count = frames < _remaining ? frames : _remaining;
+        float steps = static_cast<float> (count);
+
+        if (_multiplier == 1.f) {
+            _level += steps*_increment;
+        } else {
+            // closed form of the recurrence after count steps
+            _level = _target + (_level - _target)*powf (_multiplier, steps);
+        }
+
+        _remaining -= count;
+        frames -= count;
+
+        if (_remaining == 0) {
+            // a finished segment lands exactly on its end-level
+            _level = _target;
+            enter (static_cast<Stage> (_stage + 1));
+        }
+    }
+}
+
+void Envelope::enter (Stage stage)
+{
+    if (stage > Release) {
+        stage = Idle;
+    }
+
+    _stage = stage;
+    _multiplier = 1.f;
+    _increment = .0f;
+
+    float time = .0f;
+    switch (_stage) {
+        case Attack :
+            _target = attackLevel;
+            time = attackTime;
+        break;
+
+        case Decay :
+            _target = sustainLevel;
+            time = decayTime;
+        break;
+
+        case Release :
+            _target = .0f;
+            time = releaseTime;
+        break;
+
+        case Sustain :
+            // decayed to silence, there is nothing to hold until the
+            // note-off and the voice is free for another note
+            if (_level <= .0f) {
+                enter (Idle);
+                return;
+            }
+            _target = _level;
+            _remaining = SIZE_MAX;
+            return;
+
+        default :
+            _level = .0f;
+            _target = .0f;
+            _remaining = SIZE_MAX;
+            noteActive = false;
+            return;
+    }
+
+    float samples = std::max (1.f, roundf (time*sampleRate));
+    _remaining = static_cast<size_t> (samples);
+
+    if (_stage == Attack) {
+        _increment = (_target - _level)/samples;
+    } else {
+        _multiplier = powf (CURVE_RESIDUE, 1.f/samples);
+        _increment = _target*(1.f - _multiplier);
+    }
+}
@@ -0,0 +1,215 @@
+#include <cmath>
+#include <utility>
+
+#include "fft.h"
+
+// same switch as the kernels, to check the vector-paths against the fallback
+#if defined(__SSE2__) && !defined(KERNELS_FORCE_SCALAR)
+#include <emmintrin.h>
+#define FFT_SSE2
+#elif defined(__ARM_NEON) && !defined(KERNELS_FORCE_SCALAR)
+#include <arm_neon.h>
+#define FFT_NEON
+#endif
+
+FftPlan::FftPlan (size_t size)
+    : _size {size}
+    , _reversed (size)
+    , _real (size, .0f)
+    , _imag (size, .0f)
+{
+    int bits = 0;
+    while ((static_cast<size_t> (1) << bits) < _size) {
+        ++bits;
+    }
+
+    for (size_t i = 0; i < _size; ++i) {
+        uint32_t reversed = 0;
+        for (int bit = 0; bit < bits; ++bit) {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        _reversed[i] = reversed;
+    }
+
+    // computed in double, the errors of the factors add up over the stages
+    for (size_t half = 4; half < _size; half *= 2) {
+        for (size_t k = 0; k < half; ++k) {
+            double angle = -M_PI*static_cast<double> (k)/static_cast<double> (half);
+            _twiddleReal.push_back (static_cast<float> (cos (angle)));
+            _twiddleImag.push_back (static_cast<float> (sin (angle)));
+        }
+    }
+}
+
+size_t FftPlan::size () const
+{
+    return _size;
+}
+
+float* FftPlan::real ()
+{
+    return _real.data ();
+}
+
+float* FftPlan::imag ()
+{
+    return _imag.data ();
+}
+
+void FftPlan::transform ()
+{
+    float* re = _real.data ();
+    float* im = _imag.data ();
+
+    for (size_t i = 0; i < _size; ++i) {
+        size_t j = _reversed[i];
+        if (i < j) {
+            std::swap (re[i], re[j]);
+            std::swap (im[i], im[j]);
+        }
+    }
+
+    // the first two stages at once, their twiddle-factors are 1 and -i
+    for (size_t i = 0; i < _size; i += 4) {
+        float r0 = re[i] + re[i + 1];
+        float i0 = im[i] + im[i + 1];
+        float r1 = re[i] - re[i + 1];
+        float i1 = im[i] - im[i + 1];
+        float r2 = re[i + 2] + re[i + 3];
+        float i2 = im[i + 2] + im[i + 3];
+        float r3 = re[i + 2] - re[i + 3];
+        float i3 = im[i + 2] - im[i + 3];
+
+        re[i] = r0 + r2;
+        im[i] = i0 + i2;
+        re[i + 2] = r0 - r2;
+        im[i + 2] = i0 - i2;
+        re[i + 1] = r1 + i3;
+        im[i + 1] = i1 - r3;
+        re[i + 3] = r1 - i3;
+        im[i + 3] = i1 + r3;
+    }
+
+    // from here on every half-size is a multiple of four
+    for (size_t half = 4; half < _size; half *= 2) {
+        const float* wr = _twiddleReal.data () + half - 4;
+        const float* wi = _twiddleImag.data () + half - 4;
+
+        for (size_t start = 0; start < _size; start += 2*half) {
+            float* ur = re + start;
+            float* ui = im + start;
+            float* xr = re + start + half;
+            float* xi = im + start + half;
+
+            for (size_t k = 0; k < half; k += 4) {
+#if defined(FFT_SSE2)
+                __m128 vwr = _mm_loadu_ps (wr + k);
+                __m128 vwi = _mm_loadu_ps (wi + k);
+                __m128 vxr = _mm_loadu_ps (xr + k);
+                __m128 vxi = _mm_loadu_ps (xi + k);
+                __m128 tr = _mm_sub_ps (_mm_mul_ps (vxr, vwr), _mm_mul_ps (vxi, vwi));
+                __m128 ti = _mm_add_ps (_mm_mul_ps (vxr, vwi), _mm_mul_ps (vxi, vwr));
+                __m128 vur = _mm_loadu_ps (ur + k);
+                __m128 vui = _mm_loadu_ps (ui + k);
+                _mm_storeu_ps (ur + k, _mm_add_ps (vur, tr));
+                _mm_storeu_ps (ui + k, _mm_add_ps (vui, ti));
+                _mm_storeu_ps (xr + k, _mm_sub_ps (vur, tr));
+                _mm_storeu_ps (xi + k, _mm_sub_ps (vui, ti));
+#elif defined(FFT_NEON)
+                float32x4_t vwr = vld1q_f32 (wr + k);
+                float32x4_t vwi = vld1q_f32 (wi + k);
+                float32x4_t vxr = vld1q_f32 (xr + k);
+                float32x4_t vxi = vld1q_f32 (xi + k);
+                float32x4_t tr = vsubq_f32 (vmulq_f32 (vxr, vwr), vmulq_f32 (vxi, vwi));
+                float32x4_t ti = vaddq_f32 (vmulq_f32 (vxr, vwi), vmulq_f32 (vxi, vwr));
+                float32x4_t vur = vld1q_f32 (ur + k);
+                float32x4_t vui = vld1q_f32 (ui + k);
+                vst1q_f32 (ur + k, vaddq_f32 (vur, tr));
+                vst1q_f32 (ui + k, vaddq_f32 (vui, ti));
+                vst1q_f32 (xr + k, vsubq_f32 (vur, tr));
+                vst1q_f32 (xi + k, vsubq_f32 (vui, ti));
+#else
+                for (size_t lane = k; lane < k + 4; ++lane) {
+                    float tr = xr[lane]*wr[lane] - xi[lane]*wi[lane];
+                    float ti = xr[lane]*wi[lane] + xi[lane]*wr[lane];
+                    float vur = ur[lane];
+                    float vui = ui[lane];
+                    ur[lane] = vur + tr;
+                    ui[lane] = vui + ti;
+                    xr[lane] = vur - tr;
+                    xi[lane] = vui - ti;
+                }
+#endif
+            }
+        }
+    }
+}
+
+RealFftPlan::RealFftPlan (size_t size)
+    : _size {size}
+    , _half (size/2)
+    , _input (size, .0f)
+    , _real (size/2 + 1, .0f)
+    , _imag (size/2 + 1, .0f)
+{
+    for (size_t k = 0; k <= _size/2; ++k) {
+        double angle = -2.*M_PI*static_cast<double> (k)/static_cast<double> (_size);
+        _twiddleReal.push_back (static_cast<float> (cos (angle)));
+        _twiddleImag.push_back (static_cast<float> (sin (angle)));
+    }
+}
+
+size_t RealFftPlan::size () const
+{
+    return _size;
+}
+
+float* RealFftPlan::input ()
+{
+    return _input.data ();
+}
+
+const float* RealFftPlan::real () const
+{
+    return _real.data ();
+}
+
+const float* RealFftPlan::imag () const
+{
+    return _imag.data ();
+}
+
+void RealFftPlan::transform ()
+{
+    size_t half = _size/2;
+    float* zr = _half.real ();
+    float* zi = _half.imag ();
+
+    for (size_t n = 0; n < half; ++n) {
+        zr[n] = _input[2*n];
+        zi[n] = _input[2*n + 1];
+    }
+
+    _half.transform ();
+
+    // Z[k] and the conjugate of Z[half - k] give the spectra of the even
+    // values E[k] and of the odd ones O[k], X[k] = E[k] + W^k O[k]. DC and
+    // Nyquist both come from Z[0].
+    _real[0] = zr[0] + zi[0];
+    _imag[0] = .0f;
+    _real[half] = zr[0] - zi[0];
+    _imag[half] = .0f;
+
+    for (size_t k = 1; k < half; ++k) {
+        size_t j = half - k;
+        float er = .5f*(zr[k] + zr[j]);
+        float ei = .5f*(zi[k] - zi[j]);
+        float orr = .5f*(zi[k] + zi[j]);
+        float oi = -.5f*(zr[k] - zr[j]);
+        float wr = _twiddleReal[k];
+        float wi = _twiddleImag[k];
+
+        _real[k] = er + wr*orr - wi*oi;
+        _imag[k] = ei + wr*oi + wi*orr;
+    }
+}
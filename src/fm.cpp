@@ -0,0 +1,79 @@
+#include <cmath>
+
+#include "fm.h"
+#include "wavetable.h"
+
+#define OP(n) (1 << (n))
+
+const FmAlgorithm fmAlgorithms[FM_ALGORITHMS] = {
+    // 6 > 5 > 4 > 3 > 2 > 1
+    {{OP(1), OP(2), OP(3), OP(4), OP(5), 0}, OP(0)},
+    // 3 > 2 > 1, 6 > 5 > 4
+    {{OP(1), OP(2), 0, OP(4), OP(5), 0}, OP(0)|OP(3)},
+    // 2 > 1, 4 > 3, 6 > 5
+    {{OP(1), 0, OP(3), 0, OP(5), 0}, OP(0)|OP(2)|OP(4)},
+    // 2 + 3 + 4 + 5 + 6 > 1
+    {{OP(1)|OP(2)|OP(3)|OP(4)|OP(5), 0, 0, 0, 0, 0}, OP(0)},
+    // 6 > 5 > 4 > 1 + 2 + 3
+    {{OP(3), OP(3), OP(3), OP(4), OP(5), 0}, OP(0)|OP(1)|OP(2)},
+    // 1 + 2 + 3 + 4 + 5 + 6
+    {{0, 0, 0, 0, 0, 0}, OP(0)|OP(1)|OP(2)|OP(3)|OP(4)|OP(5)}
+};
+
+void fmSetPitch (FmVoice& voice,
+                 const FmPatch& patch,
+                 float frequency,
+                 float secondPerTick)
+{
+    for (int op = 0; op < FM_OPERATORS; ++op) {
+        voice.operators[op].setFrequency (frequency*patch.ratio[op],
+                                          secondPerTick);
+    }
+}
+
+float fmRender (FmVoice& voice,
+                const FmPatch& patch,
+                const float* sine,
+                float brightness)
+{
+    const FmAlgorithm& algorithm = fmAlgorithms[patch.algorithm];
+    float outputs[FM_OPERATORS];
+    float result = .0f;
+
+    for (int op = FM_OPERATORS - 1; op >= 0; --op) {
+        float phase = voice.operators[op].advance ();
+
+        if (patch.level[op] == .0f) {
+            outputs[op] = .0f;
+            continue;
+        }
+
+        float modulation = .0f;
+        for (int mod = op + 1; mod < FM_OPERATORS; ++mod) {
+            if (algorithm.modulators[op] & OP(mod)) {
+                modulation += outputs[mod];
+            }
+        }
+
+        if (op == FM_OPERATORS - 1) {
+            // averaging the last two outputs tames the feedback-loop
+            modulation += patch.feedback*.5f*(voice.feedback[0] +
+                                              voice.feedback[1]);
+        }
+
+        phase += modulation;
+        phase -= floorf (phase);
+        outputs[op] = patch.level[op]*Wavetable::lookup (sine, phase);
+
+        if (algorithm.carriers & OP(op)) {
+            result += outputs[op];
+        } else {
+            outputs[op] *= brightness;
+        }
+    }
+
+    voice.feedback[1] = voice.feedback[0];
+    voice.feedback[0] = outputs[FM_OPERATORS - 1];
+
+    return result;
+}
@@ -0,0 +1,174 @@
+#include "kernels.h"
+#include "wavetable.h"
+
+// define KERNELS_FORCE_SCALAR to check the vector-paths against the fallback
+#if defined(__SSE2__) && !defined(KERNELS_FORCE_SCALAR)
+#include <emmintrin.h>
+#define KERNELS_SSE2
+#elif defined(__ARM_NEON) && !defined(KERNELS_FORCE_SCALAR)
+#include <arm_neon.h>
+#define KERNELS_NEON
+#endif
+
+// fractional part of a non-negative value, the same way for all paths
+static inline float wrap (float value)
+{
+    return value - static_cast<float> (static_cast<int> (value));
+}
+
+void kernelPhases (float* phases, Oscillator& osc, size_t frames)
+{
+    float lanes[KERNEL_LANES];
+    for (int lane = 0; lane < KERNEL_LANES; ++lane) {
+        lanes[lane] = wrap (osc.phase + static_cast<float> (lane)*osc.increment);
+    }
+    float step = wrap (static_cast<float> (KERNEL_LANES)*osc.increment);
+
+    size_t i = 0;
+#if defined(KERNELS_SSE2)
+    __m128 vPhase = _mm_loadu_ps (lanes);
+    __m128 vStep = _mm_set1_ps (step);
+    for (; i + KERNEL_LANES <= frames; i += KERNEL_LANES) {
+        _mm_storeu_ps (phases + i, vPhase);
+        vPhase = _mm_add_ps (vPhase, vStep);
+        vPhase = _mm_sub_ps (vPhase, _mm_cvtepi32_ps (_mm_cvttps_epi32 (vPhase)));
+    }
+    _mm_storeu_ps (lanes, vPhase);
+#elif defined(KERNELS_NEON)
+    float32x4_t vPhase = vld1q_f32 (lanes);
+    float32x4_t vStep = vdupq_n_f32 (step);
+    for (; i + KERNEL_LANES <= frames; i += KERNEL_LANES) {
+        vst1q_f32 (phases + i, vPhase);
+        vPhase = vaddq_f32 (vPhase, vStep);
+        vPhase = vsubq_f32 (vPhase, vcvtq_f32_s32 (vcvtq_s32_f32 (vPhase)));
+    }
+    vst1q_f32 (lanes, vPhase);
+#else
+    for (; i + KERNEL_LANES <= frames; i += KERNEL_LANES) {
+        for (int lane = 0; lane < KERNEL_LANES; ++lane) {
+            phases[i + lane] = lanes[lane];
+            lanes[lane] = wrap (lanes[lane] + step);
+        }
+    }
+#endif
+
+    size_t rest = frames - i;
+    for (size_t lane = 0; lane < rest; ++lane) {
+        phases[i + lane] = lanes[lane];
+    }
+    osc.phase = lanes[rest];
+}
+
+void kernelSine (float* out, const float* phases, size_t frames)
+{
+    size_t i = 0;
+#if defined(KERNELS_SSE2)
+    __m128 vScale = _mm_set1_ps (20.785f);
+    __m128 vLinear = _mm_set1_ps (1.5f);
+    __m128 vConstant = _mm_set1_ps (.5f);
+    for (; i + KERNEL_LANES <= frames; i += KERNEL_LANES) {
+        __m128 x = _mm_loadu_ps (phases + i);
+        __m128 poly = _mm_add_ps (_mm_sub_ps (_mm_mul_ps (x, x),
+                                              _mm_mul_ps (vLinear, x)),
+                                  vConstant);
+        __m128 value = _mm_mul_ps (_mm_mul_ps (vScale, x), poly);
+        _mm_storeu_ps (out + i, _mm_add_ps (_mm_loadu_ps (out + i), value));
+    }
+#elif defined(KERNELS_NEON)
+    float32x4_t vScale = vdupq_n_f32 (20.785f);
+    float32x4_t vLinear = vdupq_n_f32 (1.5f);
+    float32x4_t vConstant = vdupq_n_f32 (.5f);
+    for (; i + KERNEL_LANES <= frames; i += KERNEL_LANES) {
+        float32x4_t x = vld1q_f32 (phases + i);
+        float32x4_t poly = vaddq_f32 (vsubq_f32 (vmulq_f32 (x, x),
+                                                 vmulq_f32 (vLinear, x)),
+                                      vConstant);
+        float32x4_t value = vmulq_f32 (vmulq_f32 (vScale, x), poly);
+        vst1q_f32 (out + i, vaddq_f32 (vld1q_f32 (out + i), value));
+    }
+#endif
+
+    for (; i < frames; ++i) {
+        out[i] += customSin (phases[i]);
+    }
+}
+
+void kernelWavetable (float* out,
+                      const float* table,
+                      const float* phases,
+                      size_t frames)
+{
+    // neither SSE2 nor NEON can gather, the plain loop is as good as it gets
+    for (size_t i = 0; i < frames; ++i) {
+        out[i] += Wavetable::lookup (table, phases[i]);
+    }
+}
+
+void kernelInterleaveGain (float* stereo,
+                           const float* left,
+                           const float* right,
+                           const float* gain,
+                           size_t frames)
+{
+    size_t i = 0;
+#if defined(KERNELS_SSE2)
+    for (; i + KERNEL_LANES <= frames; i += KERNEL_LANES) {
+        __m128 vGain = _mm_loadu_ps (gain + i);
+        __m128 vLeft = _mm_mul_ps (_mm_loadu_ps (left + i), vGain);
+        __m128 vRight = _mm_mul_ps (_mm_loadu_ps (right + i), vGain);
+        _mm_storeu_ps (stereo + 2*i, _mm_unpacklo_ps (vLeft, vRight));
+        _mm_storeu_ps (stereo + 2*i + KERNEL_LANES, _mm_unpackhi_ps (vLeft, vRight));
+    }
+#elif defined(KERNELS_NEON)
+    for (; i + KERNEL_LANES <= frames; i += KERNEL_LANES) {
+        float32x4_t vGain = vld1q_f32 (gain + i);
+        float32x4x2_t vStereo = vzipq_f32 (vmulq_f32 (vld1q_f32 (left + i), vGain),
+                                           vmulq_f32 (vld1q_f32 (right + i), vGain));
+        vst1q_f32 (stereo + 2*i, vStereo.val[0]);
+        vst1q_f32 (stereo + 2*i + KERNEL_LANES, vStereo.val[1]);
+    }
+#endif
+
+    for (; i < frames; ++i) {
+        stereo[2*i] = left[i]*gain[i];
+        stereo[2*i + 1] = right[i]*gain[i];
+    }
+}
+
+void kernelScale (float* data, float factor, size_t samples)
+{
+    size_t i = 0;
+#if defined(KERNELS_SSE2)
+    __m128 vFactor = _mm_set1_ps (factor);
+    for (; i + KERNEL_LANES <= samples; i += KERNEL_LANES) {
+        _mm_storeu_ps (data + i, _mm_mul_ps (_mm_loadu_ps (data + i), vFactor));
+    }
+#elif defined(KERNELS_NEON)
+    for (; i + KERNEL_LANES <= samples; i += KERNEL_LANES) {
+        vst1q_f32 (data + i, vmulq_n_f32 (vld1q_f32 (data + i), factor));
+    }
+#endif
+
+    for (; i < samples; ++i) {
+        data[i] *= factor;
+    }
+}
+
+void kernelAccumulate (float* out, const float* in, size_t samples)
+{
+    size_t i = 0;
+#if defined(KERNELS_SSE2)
+    for (; i + KERNEL_LANES <= samples; i += KERNEL_LANES) {
+        _mm_storeu_ps (out + i, _mm_add_ps (_mm_loadu_ps (out + i),
+                                            _mm_loadu_ps (in + i)));
+    }
+#elif defined(KERNELS_NEON)
+    for (; i + KERNEL_LANES <= samples; i += KERNEL_LANES) {
+        vst1q_f32 (out + i, vaddq_f32 (vld1q_f32 (out + i), vld1q_f32 (in + i)));
+    }
+#endif
+
+    for (; i < samples; ++i) {
+        out[i] += in[i];
+    }
+}
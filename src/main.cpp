@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "application.h"
+#include "offline.h"
 
 #define WIDTH 1024*1.5
 #define HEIGHT 512*1.5
@@ -11,11 +12,21 @@ int main (int argc, char** argv)
 {
 	string midiPort = "hw:1,0,0";
 
-	if (argc == 2) {
+	if (argc == 4 && string (argv[1]) == "--render") {
+		return renderOffline (argv[2], argv[3]) ? 0 : 1;
+	}
+
+	string smfFile;
+	if (argc >= 3 && string (argv[1]) == "--play") {
+		smfFile = argv[2];
+		if (argc == 4) {
+			midiPort = argv[3];
+		}
+	} else if (argc == 2) {
 		midiPort = argv[1];
 	}
 
-    Application app (WIDTH, HEIGHT, midiPort);
+    Application app (WIDTH, HEIGHT, midiPort, smfFile);
     app.run ();
 
     return 0;
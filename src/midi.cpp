@@ -1,11 +1,17 @@
+#include <chrono>
 #include <cmath>
 #include <iostream>
+#include <thread>
 #include <vector>
 
-#include <SDL.h>
-
 #include "midi.h"
 
+static double secondsNow ()
+{
+	using namespace std::chrono;
+	return duration<double> (steady_clock::now ().time_since_epoch ()).count ();
+}
+
 Midi::Midi (const std::string& port)
 	: _midiPortInput {nullptr}
 	, _midiPortOutput {nullptr}
@@ -49,32 +55,29 @@ void Midi::setPadColor (const unsigned char padNum, const PadColor color) const
 	}
 }
 
-MessageData Midi::read () const
+MidiEvent Midi::read () const
 {
  	char buffer[1];
  	char buffer2[2];
- 	float timeStamp = .0f;
- 	MessageData messageData = std::make_tuple(MessageType::None, 0, 0, .0f);
+ 	MidiEvent event = {MessageType::None, 0, 0, .0};
 	int result = snd_rawmidi_read (_midiPortInput, buffer, 1);
 	if (result > 0) {
 		unsigned char midiMessage = static_cast<unsigned char>(buffer[0]);
 		switch (midiMessage) {
 			case MessageType::NoteOff:
 				result = snd_rawmidi_read (_midiPortInput, buffer2, 2);
-				timeStamp = static_cast<float>(SDL_GetTicks())*.001f;
-				messageData = std::make_tuple (MessageType::NoteOff,
-											  buffer2[0],
-											  buffer2[1],
-											  timeStamp);
+				event.type = MessageType::NoteOff;
+				event.noteId = static_cast<unsigned char> (buffer2[0]);
+				event.velocity = static_cast<unsigned char> (buffer2[1]);
+				event.timeStamp = secondsNow ();
 			break;
 
 			case MessageType::NoteOn:
 				result = snd_rawmidi_read (_midiPortInput, buffer2, 2);
-				timeStamp = static_cast<float>(SDL_GetTicks())*.001f;
-				messageData = std::make_tuple (MessageType::NoteOn,
-											   buffer2[0],
-											   buffer2[1],
-											   timeStamp);
+				event.type = MessageType::NoteOn;
+				event.noteId = static_cast<unsigned char> (buffer2[0]);
+				event.velocity = static_cast<unsigned char> (buffer2[1]);
+				event.timeStamp = secondsNow ();
 			break;
 
 			case MessageType::AfterTouch:
@@ -104,7 +107,7 @@ MessageData Midi::read () const
 		}
 	}
 
-	return messageData;
+	return event;
 }
 
 Midi::~Midi ()
@@ -125,7 +128,7 @@ bool Midi::initialized () const
 // A little disco-effect for the drum-pads on the Arturia MiniLab mkII
 void Midi::padColorCycle () const
 {
-	int pause = 5;
+	std::chrono::milliseconds pause (5);
 	unsigned char start = 0;
 	unsigned char end = 8;
 	std::vector<PadColor> colors = {PadColor::White,
@@ -137,24 +140,23 @@ void Midi::padColorCycle () const
 									PadColor::Green};
 
 	int index = 0;
-	for (auto color : colors) {
+	for (size_t round = 0; round < colors.size (); ++round) {
 		for (unsigned char foo = start; foo < end; ++foo) {
-			std::ignore = color;
 			++index;
 			for (unsigned char pad = start; pad < end; ++pad) {
 				setPadColor (pad, pad == foo ? colors[index%7] : PadColor::Black);
-				SDL_Delay (pause);
+				std::this_thread::sleep_for (pause);
 			}
 		}
 
 		for (unsigned char foo = start + 2; foo <= end; ++foo) {
 			for (unsigned char pad = start; pad < end; ++pad) {
 				setPadColor (pad, pad == (end - foo) ? colors[index%7] : PadColor::Black);
-				SDL_Delay (pause);
+				std::this_thread::sleep_for (pause);
 			}
 		}
 
 		setPadColor (start, PadColor::Black);
-		SDL_Delay (pause);
+		std::this_thread::sleep_for (pause);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+#include "offline.h"
+#include "smf.h"
+#include "synth.h"
+
+using namespace std;
+using namespace std::chrono;
+
+#define newline '\n'
+
+#define OFFLINE_SAMPLE_RATE 48000
+#define OFFLINE_CHANNELS 2
+#define OFFLINE_BLOCK 1024
+#define OFFLINE_FREQUENCY_BINS 512
+// notes still held after the last command are cut off after this
+#define OFFLINE_MAX_TAIL 10.
+// the sizes in a WAV-header are 32 bits, the RIFF-chunk's includes the 36
+// bytes of header before the data
+#define OFFLINE_MAX_DATA_BYTES (0xffffffffull - 36)
+
+static bool parseCommand (const string& word,
+                          istringstream& arguments,
+                          SynthCommand& command)
+{
+    command.noteId = 0;
+    command.value = .0f;
+
+    if (word == "on" || word == "off") {
+        int note = 0;
+        float velocity = 100.f;
+        if (!(arguments >> note)) {
+            return false;
+        }
+        arguments >> velocity;
+        command.type = word == "on" ? NoteOnCommand : NoteOffCommand;
+        command.noteId = note - NOTE_ID_OFFSET;
+        command.value = velocity/128.f;
+        return true;
+    }
+
+    if (word == "steal") {
+        string name;
+        arguments >> name;
+        for (int policy = 0; policy < STEAL_POLICIES; ++policy) {
+            if (name == stealPolicyNames[policy]) {
+                command.type = SetStealPolicy;
+                command.value = static_cast<float> (policy);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (!(arguments >> command.value)) {
+        return false;
+    }
+
+    if (word == "instrument") {
+        command.type = SetInstrument;
+    } else if (word == "algorithm") {
+        command.type = SetFmAlgorithm;
+        command.value -= 1.f;
+    } else if (word == "volume") {
+        command.type = SetVolume;
+    } else if (word == "dirty") {
+        command.type = SetDirty;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+static bool readScript (const string& eventFile, vector<SynthCommand>& script)
+{
+    ifstream file (eventFile);
+    if (!file) {
+        cout << "could not open " << eventFile << newline;
+        return false;
+    }
+
+    string line;
+    size_t lineNumber = 0;
+    while (getline (file, line)) {
+        ++lineNumber;
+        line = line.substr (0, line.find ('#'));
+
+        istringstream fields (line);
+        double time = .0;
+        string word;
+        if (!(fields >> time)) {
+            if (fields.eof ()) {
+                continue;
+            }
+        }
+
+        SynthCommand command;
+        if (!(fields >> word) || time < .0 || !parseCommand (word, fields, command)) {
+            cout << eventFile << ":" << lineNumber << ": cannot parse \""
+                 << line << "\"" << newline;
+            return false;
+        }
+
+        command.timeStamp = time;
+        script.push_back (command);
+    }
+
+    // keeps note-on and note-off at the same time in the order written
+    stable_sort (script.begin (),
+                 script.end (),
+                 [] (const SynthCommand& a, const SynthCommand& b) {
+                     return a.timeStamp < b.timeStamp;
+                 });
+
+    return true;
+}
+
+static void writeLittleEndian (ofstream& file, uint32_t value, int bytes)
+{
+    for (int byte = 0; byte < bytes; ++byte) {
+        file.put (static_cast<char> ((value >> 8*byte) & 0xff));
+    }
+}
+
+// WAV is little-endian whatever the host is
+static void writeSamples (ofstream& file, const vector<float>& samples, vector<char>& bytes)
+{
+    for (size_t i = 0; i < samples.size (); ++i) {
+        uint32_t value;
+        memcpy (&value, &samples[i], sizeof value);
+        for (int byte = 0; byte < 4; ++byte) {
+            bytes[4*i + byte] = static_cast<char> ((value >> 8*byte) & 0xff);
+        }
+    }
+    file.write (bytes.data (), 4*samples.size ());
+}
+
+static void writeWavHeader (ofstream& file, uint64_t frames)
+{
+    uint32_t dataBytes = static_cast<uint32_t> (frames*OFFLINE_CHANNELS*sizeof (float));
+
+    file.write ("RIFF", 4);
+    writeLittleEndian (file, 36 + dataBytes, 4);
+    file.write ("WAVE", 4);
+    file.write ("fmt ", 4);
+    writeLittleEndian (file, 16, 4);
+    // IEEE float
+    writeLittleEndian (file, 3, 2);
+    writeLittleEndian (file, OFFLINE_CHANNELS, 2);
+    writeLittleEndian (file, OFFLINE_SAMPLE_RATE, 4);
+    writeLittleEndian (file, OFFLINE_SAMPLE_RATE*OFFLINE_CHANNELS*sizeof (float), 4);
+    writeLittleEndian (file, OFFLINE_CHANNELS*sizeof (float), 2);
+    writeLittleEndian (file, 8*sizeof (float), 2);
+    file.write ("data", 4);
+    writeLittleEndian (file, dataBytes, 4);
+}
+
+static bool isSmf (const string& path)
+{
+    ifstream file (path, ios::binary);
+    char magic[4];
+    return file.read (magic, 4) && string (magic, 4) == "MThd";
+}
+
+bool renderOffline (const string& eventFile, const string& wavFile)
+{
+    vector<SynthCommand> script;
+    size_t next = 0;
+    Smf smf;
+    std::function<bool (SynthCommand&)> nextCommand;
+    bool fromSmf = isSmf (eventFile);
+
+    if (fromSmf) {
+        if (!smf.open (eventFile)) {
+            return false;
+        }
+        // streamed while rendering, never read as a whole
+        nextCommand = [&smf] (SynthCommand& command) {
+            MidiEvent event;
+            if (!smf.next (event)) {
+                return false;
+            }
+            command.type = event.type == MessageType::NoteOn ? NoteOnCommand
+                                                             : NoteOffCommand;
+            command.noteId = static_cast<NoteId> (event.noteId) - NOTE_ID_OFFSET;
+            command.value = static_cast<float> (event.velocity)/128.f;
+            command.timeStamp = event.timeStamp;
+            return true;
+        };
+    } else {
+        if (!readScript (eventFile, script)) {
+            return false;
+        }
+        nextCommand = [&script, &next] (SynthCommand& command) {
+            if (next == script.size ()) {
+                return false;
+            }
+            command = script[next++];
+            return true;
+        };
+    }
+
+    ofstream file (wavFile, ios::binary);
+    if (!file) {
+        cout << "could not create " << wavFile << newline;
+        return false;
+    }
+    // the sizes are filled in once the length is known
+    writeWavHeader (file, 0);
+
+    Synth synth (16, OFFLINE_SAMPLE_RATE);
+    SynthData synthData;
+    setupSynthData (synthData,
+                    synth,
+                    OFFLINE_SAMPLE_RATE,
+                    OFFLINE_CHANNELS,
+                    OFFLINE_BLOCK,
+                    OFFLINE_FREQUENCY_BINS);
+    RingBuffer<SynthCommand> commands (COMMAND_CAPACITY);
+    synthData.commands = &commands;
+
+    vector<float> block (OFFLINE_BLOCK*OFFLINE_CHANNELS);
+    vector<char> bytes (block.size ()*sizeof (float));
+    bool full = false;
+    SynthCommand command;
+    bool pending = nextCommand (command);
+    double lastTime = .0;
+
+    auto start = steady_clock::now ();
+
+    // The script is fed through the same command-ring as the UI does, with
+    // the stream-position as the clock. The frame of a command then comes
+    // out at exactly its time-stamp times the sample-rate.
+    while (true) {
+        if ((synthData.frames + OFFLINE_BLOCK)*OFFLINE_CHANNELS*sizeof (float) > OFFLINE_MAX_DATA_BYTES) {
+            full = true;
+            break;
+        }
+
+        double blockEnd = static_cast<double> (synthData.frames + OFFLINE_BLOCK)/OFFLINE_SAMPLE_RATE;
+        while (pending &&
+               command.timeStamp < blockEnd &&
+               commands.push (command)) {
+            lastTime = command.timeStamp;
+            pending = nextCommand (command);
+        }
+
+        std::fill (block.begin (), block.end (), .0f);
+        renderSynth (synthData, block.data (), OFFLINE_BLOCK, blockEnd);
+        writeSamples (file, block, bytes);
+
+        // the pad's lanes fade out in the block after their note is gone
+        bool done = !pending && synthData.events.empty ();
+        bool silent = synth.activeNotes () == 0 && !synthData.voiceBank->sounding ();
+        if (done && (silent || blockEnd > lastTime + OFFLINE_MAX_TAIL)) {
+            break;
+        }
+    }
+
+    auto end = steady_clock::now ();
+
+    file.seekp (0);
+    writeWavHeader (file, synthData.frames);
+    if (!file) {
+        cout << "could not write " << wavFile << newline;
+        return false;
+    }
+
+    if (fromSmf && !smf.good ()) {
+        cout << eventFile << " is broken, rendered what could be read" << newline;
+    }
+    if (full) {
+        cout << wavFile << " reached the 4 GiB a WAV-file can hold, stopped there" << newline;
+    }
+
+    double renderSeconds = duration<double> (end - start).count ();
+    double audioSeconds = static_cast<double> (synthData.frames)/OFFLINE_SAMPLE_RATE;
+    cout << "rendered " << audioSeconds << "s of audio in "
+         << renderSeconds << "s, " << audioSeconds/renderSeconds
+         << "x real-time" << newline;
+    synthData.monitor->report ();
+    cout << "voices stolen: " << synth.steals ()
+         << ", retriggered: " << synth.retriggers ()
+         << ", cut: " << synth.hardCuts () << newline;
+    if (synthData.droppedNoteOns > 0 || synthData.earlyNoteOffs > 0) {
+        cout << "note-ons dropped: " << synthData.droppedNoteOns
+             << ", note-offs applied early: " << synthData.earlyNoteOffs
+             << " (capacity " << MAX_PENDING_EVENTS << ")" << newline;
+    }
+
+    return true;
+}
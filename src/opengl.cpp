@@ -2,13 +2,27 @@
 #include <GL/glew.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 #include "opengl.h"
 #include "shaders.h"
 
-enum VertexAttribs {
-    PositionAttr = 0,
+const char* displayModeNames[] = {"scope", "spectrum", "spectrogram"};
+
+// the colour-table of the spectrogram runs through these, evenly spaced
+static const float spectrogramStops[][3] = {
+    {.0f, .0f, .0f},
+    {.1f, .0f, .4f},
+    {.6f, .0f, .5f},
+    {1.f, .3f, .0f},
+    {1.f, .9f, .2f},
+    {1.f, 1.f, 1.f},
 };
 
 OpenGL::OpenGL (unsigned int width, unsigned int height)
@@ -28,46 +42,107 @@ OpenGL::OpenGL (unsigned int width, unsigned int height)
 
 OpenGL::~OpenGL ()
 {
+    for (GLsync fence : _fences) {
+        if (fence) {
+            glDeleteSync (fence);
+        }
+    }
 }
  
-bool OpenGL::init (size_t audioBufferSize, size_t frequencyBins)
+bool OpenGL::init (size_t scopeColumns, size_t frequencyBins)
 {
-    _audioBufferSize = audioBufferSize;
-    std::cout << "buffer size: " << _audioBufferSize << '\n';
-
     glClearColor (.075f, .075f, .075f, 1.);
     glViewport (0, 0, _width, _height);
     glLineWidth(2.f);
     glEnable (GL_BLEND);
 
-    _program = createShaderProgram (vert, frag, true);
+    _program = createCachedProgram (vert, frag);
 
     glGenVertexArrays (1, &_vao);
-    glGenBuffers (1, &_vbo);
-
-    size_t size = _audioBufferSize;
-    std::vector<GLfloat> quad (size);
-    for (int i = 0; i < quad.size(); i += 2) {
-        float x = static_cast<float>(i);
-        quad[i] = (x/_audioBufferSize)*(_width/_height) - 1.f;
-        quad[i+1] = .0f;
+    glGenBuffers (1, &_samples);
+    glGenTextures (1, &_samplesTexture);
+
+    // one column-extreme of the scope or bin of the spectrum per vertex
+    _vertexCapacity = std::max (2*scopeColumns, frequencyBins/2);
+
+    glBindBuffer (GL_TEXTURE_BUFFER, _samples);
+    if (GLEW_ARB_buffer_storage) {
+        GLsizeiptr bytes = STREAM_REGIONS*_vertexCapacity*sizeof (GLfloat);
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage (GL_TEXTURE_BUFFER, bytes, nullptr, flags);
+        _mapped = static_cast<GLfloat*> (glMapBufferRange (GL_TEXTURE_BUFFER, 0, bytes, flags));
+    } else {
+        glBufferData (GL_TEXTURE_BUFFER,
+                      _vertexCapacity*sizeof (GLfloat),
+                      nullptr,
+                      GL_STREAM_DRAW);
     }
+    glBindTexture (GL_TEXTURE_BUFFER, _samplesTexture);
+    glTexBuffer (GL_TEXTURE_BUFFER, GL_R32F, _samples);
+    glBindTexture (GL_TEXTURE_BUFFER, 0);
+    glBindBuffer (GL_TEXTURE_BUFFER, 0);
+
+    _firstLocation = glGetUniformLocation (_program, "uFirst");
+    _stepLocation = glGetUniformLocation (_program, "uStep");
+    _offsetLocation = glGetUniformLocation (_program, "uOffset");
+    glUseProgram (_program);
+    glUniform1i (glGetUniformLocation (_program, "uSamples"), 0);
+    glUseProgram (0);
 
-    glBindVertexArray (_vao);
-    glBindBuffer (GL_ARRAY_BUFFER, _vbo);
-    glBufferData (GL_ARRAY_BUFFER, quad.size() * sizeof (GLfloat), quad.data(), GL_DYNAMIC_DRAW); 
-    glBindAttribLocation (_program, PositionAttr, "aPosition");
-    GLchar* offset = 0;
-    glVertexAttribPointer (PositionAttr,
-                           2,
-                           GL_FLOAT,
-                           GL_FALSE,
-                           0,
-                           offset);
-    glEnableVertexAttribArray (PositionAttr);
+    // one column per bin of the spectrum, starting out silent
+    _spectrogramBins = frequencyBins/2;
+    _spectrogramProgram = createCachedProgram (spectrogramVert, spectrogramFrag);
+    _scrollLocation = glGetUniformLocation (_spectrogramProgram, "uScroll");
+    glUseProgram (_spectrogramProgram);
+    glUniform1i (glGetUniformLocation (_spectrogramProgram, "uHistory"), 1);
+    glUniform1i (glGetUniformLocation (_spectrogramProgram, "uColors"), 2);
+    glUseProgram (0);
 
-    glBindVertexArray (0);
-    glBindBuffer (GL_ARRAY_BUFFER, 0);
+    std::vector<GLfloat> silence (_spectrogramBins*SPECTROGRAM_ROWS, .0f);
+    glGenTextures (1, &_spectrogram);
+    glBindTexture (GL_TEXTURE_2D, _spectrogram);
+    glTexImage2D (GL_TEXTURE_2D,
+                  0,
+                  GL_R32F,
+                  _spectrogramBins,
+                  SPECTROGRAM_ROWS,
+                  0,
+                  GL_RED,
+                  GL_FLOAT,
+                  silence.data ());
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture (GL_TEXTURE_2D, 0);
+
+    size_t stops = sizeof spectrogramStops/sizeof spectrogramStops[0];
+    std::vector<GLubyte> colors (4*SPECTROGRAM_COLORS);
+    for (size_t i = 0; i < SPECTROGRAM_COLORS; ++i) {
+        float position = static_cast<float> (i*(stops - 1))/(SPECTROGRAM_COLORS - 1);
+        size_t stop = std::min (static_cast<size_t> (position), stops - 2);
+        float fraction = position - stop;
+        for (size_t c = 0; c < 3; ++c) {
+            float value = spectrogramStops[stop][c] +
+                          fraction*(spectrogramStops[stop + 1][c] - spectrogramStops[stop][c]);
+            colors[4*i + c] = static_cast<GLubyte> (255.f*value + .5f);
+        }
+        colors[4*i + 3] = 255;
+    }
+    glGenTextures (1, &_spectrogramColors);
+    glBindTexture (GL_TEXTURE_1D, _spectrogramColors);
+    glTexImage1D (GL_TEXTURE_1D,
+                  0,
+                  GL_RGBA8,
+                  SPECTROGRAM_COLORS,
+                  0,
+                  GL_RGBA,
+                  GL_UNSIGNED_BYTE,
+                  colors.data ());
+    glTexParameteri (GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri (GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri (GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glBindTexture (GL_TEXTURE_1D, 0);
 
 	return true;
 }
@@ -82,50 +157,318 @@ bool OpenGL::resize (unsigned int width, unsigned int height)
     return true;
 }
 
-bool OpenGL::draw (std::vector<float>& sampleBufferForDrawing,
-                   std::vector<float>& fftBufferForDrawing,
-                   bool doFFT)
+bool OpenGL::draw (const std::vector<float>& sampleBufferForDrawing,
+                   const std::vector<float>& fftBufferForDrawing,
+                   DisplayMode mode)
 {
+    auto start = std::chrono::steady_clock::now ();
+
     glClear (GL_COLOR_BUFFER_BIT);
 
+    switch (mode) {
+        // the minimum and maximum of each column, zig-zagging between them
+        case ScopeDisplay: drawLine (sampleBufferForDrawing,
+                                     1,
+                                     2.f/sampleBufferForDrawing.size (),
+                                     .0f);
+                           break;
+        // the first channel at the even indices
+        case SpectrumDisplay: drawLine (fftBufferForDrawing,
+                                        2,
+                                        2.f*(_width/_height)/fftBufferForDrawing.size (),
+                                        -.75f);
+                              break;
+        default: drawSpectrogram (); break;
+    }
+
+    float microseconds = std::chrono::duration<float, std::micro> (std::chrono::steady_clock::now () - start).count ();
+    _drawMicrosecondsSum += microseconds;
+    _drawMicrosecondsMax = std::max (_drawMicrosecondsMax, microseconds);
+    ++_frames;
+
+	return true;
+}
+
+void OpenGL::dump (std::ostream& out) const
+{
+    // formatted aside, out keeps its own precision
+    std::ostringstream text;
+    text << std::fixed << std::setprecision (1);
+    text << "draw of " << _frames << " frames: "
+         << (_frames > 0 ? _drawMicrosecondsSum/_frames : .0)
+         << " us CPU-time on average, max " << _drawMicrosecondsMax << '\n';
+    out << text.str ();
+}
+
+void OpenGL::drawLine (const std::vector<float>& source,
+                       size_t stride,
+                       float step,
+                       float offset)
+{
     glUseProgram (_program);
     glBindVertexArray (_vao);
+    glBindBuffer (GL_TEXTURE_BUFFER, _samples);
+    glActiveTexture (GL_TEXTURE0);
+    glBindTexture (GL_TEXTURE_BUFFER, _samplesTexture);
+
+    // only the values go up, the shader spaces them step apart
+    size_t count = std::min (source.size ()/stride, _vertexCapacity);
 
-    size_t size = sampleBufferForDrawing.size();
-    std::vector<GLfloat> quad (size);
-    for (int i = 0; i < quad.size(); i += 2) {
-        float x = static_cast<float>(i);
-        float y = sampleBufferForDrawing[i];
-        if (doFFT) {
-            y = fftBufferForDrawing[i] - .75f;
-            quad[i] = (x/fftBufferForDrawing.size())*(_width/_height) - 1.f;
-        } else {
-            quad[i] = (x/sampleBufferForDrawing.size())*(_width/_height) - 1.f;
+    GLfloat* samples = beginSamples ();
+    if (samples) {
+        for (size_t i = 0; i < count; ++i) {
+            samples[i] = source[stride*i];
+        }
+        endSamples ();
+
+        glUniform1i (_firstLocation, _mapped ? _region*_vertexCapacity : 0);
+        glUniform1f (_stepLocation, step);
+        glUniform1f (_offsetLocation, offset);
+        // no attributes, everything comes from gl_VertexID
+        glDrawArrays (GL_LINE_STRIP, 0, count);
+        if (_mapped) {
+            _fences[_region] = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
         }
-        quad[i+1] = y;
     }
 
-    glNamedBufferSubData(_vbo, 0, quad.size() * sizeof (GLfloat), quad.data());
+    glUseProgram (0);
+    glBindVertexArray (0);
+    glBindTexture (GL_TEXTURE_BUFFER, 0);
+    glBindBuffer (GL_TEXTURE_BUFFER, 0);
+}
 
-    if (doFFT) {
-        size = fftBufferForDrawing.size()/2;
-    } else {
-        size = sampleBufferForDrawing.size()/2;
-    }
-    std::vector<unsigned short> indices (size);
-    int index = 0;
-    std::generate(indices.begin(), indices.end(), [&](){
-        return index++;
-    });
-    glDrawElements (GL_LINE_STRIP,
-                    indices.size(),
-                    GL_UNSIGNED_SHORT,
-                    indices.data());
+void OpenGL::addSpectrogramRow (const std::vector<float>& spectrum)
+{
+    if (spectrum.size () < 2*_spectrogramBins) {
+        return;
+    }
+
+    // the bins are at the even indices, read as pairs of red and green only
+    // the red ones are kept
+    _spectrogramRow = (_spectrogramRow + 1) % SPECTROGRAM_ROWS;
+    glActiveTexture (GL_TEXTURE1);
+    glBindTexture (GL_TEXTURE_2D, _spectrogram);
+    glTexSubImage2D (GL_TEXTURE_2D,
+                     0,
+                     0,
+                     _spectrogramRow,
+                     _spectrogramBins,
+                     1,
+                     GL_RG,
+                     GL_FLOAT,
+                     spectrum.data ());
+    glBindTexture (GL_TEXTURE_2D, 0);
+    glActiveTexture (GL_TEXTURE0);
+}
+
+void OpenGL::drawSpectrogram ()
+{
+    glActiveTexture (GL_TEXTURE1);
+    glBindTexture (GL_TEXTURE_2D, _spectrogram);
+    glActiveTexture (GL_TEXTURE2);
+    glBindTexture (GL_TEXTURE_1D, _spectrogramColors);
+
+    glUseProgram (_spectrogramProgram);
+    glBindVertexArray (_vao);
+    glUniform1f (_scrollLocation,
+                 static_cast<float> (_spectrogramRow + 1)/SPECTROGRAM_ROWS);
+    glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
 
     glUseProgram (0);
     glBindVertexArray (0);
+    glBindTexture (GL_TEXTURE_1D, 0);
+    glActiveTexture (GL_TEXTURE1);
+    glBindTexture (GL_TEXTURE_2D, 0);
+    glActiveTexture (GL_TEXTURE0);
+}
 
-	return true;
+// Where to write the samples of this frame. A persistently mapped buffer
+// cycles through its regions, waiting only if the GPU is still drawing from
+// one STREAM_REGIONS frames later.
+GLfloat* OpenGL::beginSamples ()
+{
+    if (!_mapped) {
+        // orphaned, the driver hands out fresh storage while the GPU keeps
+        // drawing from the old one
+        GLsizeiptr bytes = _vertexCapacity*sizeof (GLfloat);
+        glBufferData (GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        return static_cast<GLfloat*> (glMapBufferRange (GL_TEXTURE_BUFFER,
+                                                        0,
+                                                        bytes,
+                                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    }
+
+    _region = (_region + 1) % STREAM_REGIONS;
+    GLsync& fence = _fences[_region];
+    if (fence) {
+        glClientWaitSync (fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+        glDeleteSync (fence);
+        fence = nullptr;
+    }
+    return _mapped + _region*_vertexCapacity;
+}
+
+void OpenGL::endSamples ()
+{
+    if (!_mapped) {
+        glUnmapBuffer (GL_TEXTURE_BUFFER);
+    }
+}
+
+// Links the program from the binary a previous run left in the cache if
+// there is one for the same sources and driver, else compiles and links it
+// and leaves the binary there for the next run.
+GLuint OpenGL::createCachedProgram (const char* vertSrc, const char* fragSrc)
+{
+    auto start = std::chrono::steady_clock::now ();
+
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary) {
+        glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    std::string path;
+    if (formats > 0) {
+        path = programCachePath (vertSrc, fragSrc);
+    }
+
+    GLuint program = 0;
+    bool cached = false;
+    if (!path.empty ()) {
+        program = loadProgramBinary (path);
+        cached = program != 0;
+    }
+    if (!cached) {
+        program = createShaderProgram (vertSrc, fragSrc, true);
+        // 0 if it did not compile or link, nothing to keep then
+        if (program && !path.empty ()) {
+            storeProgramBinary (program, path);
+        }
+    }
+
+    float milliseconds = std::chrono::duration<float, std::milli> (std::chrono::steady_clock::now () - start).count ();
+    std::cout << "shader-program " << (cached ? "loaded from the cache" : program ? "compiled" : "failed")
+              << " in " << milliseconds << " ms" << '\n';
+    return program;
+}
+
+// named after a hash of the sources and of what the driver says it is, a
+// binary only fits the driver that produced it
+std::string OpenGL::programCachePath (const char* vertSrc, const char* fragSrc) const
+{
+    std::filesystem::path directory;
+    if (const char* cache = std::getenv (PROGRAM_CACHE_VARIABLE)) {
+        directory = cache;
+    } else if (const char* cache = std::getenv ("XDG_CACHE_HOME")) {
+        directory = std::filesystem::path (cache)/"software-synthesizer";
+    } else if (const char* home = std::getenv ("HOME")) {
+        directory = std::filesystem::path (home)/".cache"/"software-synthesizer";
+    } else {
+        return "";
+    }
+
+    const char* parts[] = {
+        vertSrc,
+        fragSrc,
+        reinterpret_cast<const char*> (glGetString (GL_VENDOR)),
+        reinterpret_cast<const char*> (glGetString (GL_RENDERER)),
+        reinterpret_cast<const char*> (glGetString (GL_VERSION)),
+    };
+    // FNV-1a, with each part's terminating zero so they cannot run together
+    uint64_t hash = 14695981039346656037ull;
+    for (const char* part : parts) {
+        if (!part) {
+            part = "";
+        }
+        do {
+            hash ^= static_cast<unsigned char> (*part);
+            hash *= 1099511628211ull;
+        } while (*part++);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories (directory, error);
+    if (error) {
+        return "";
+    }
+
+    std::ostringstream name;
+    name << std::hex << std::setw (16) << std::setfill ('0') << hash << ".bin";
+    return (directory/name.str ()).string ();
+}
+
+// 0 if there is no binary or the driver does not take it anymore
+GLuint OpenGL::loadProgramBinary (const std::string& path) const
+{
+    std::ifstream file (path, std::ios::binary);
+    uint32_t magic = 0;
+    GLenum format = 0;
+    uint32_t length = 0;
+    file.read (reinterpret_cast<char*> (&magic), sizeof magic);
+    file.read (reinterpret_cast<char*> (&format), sizeof format);
+    file.read (reinterpret_cast<char*> (&length), sizeof length);
+    if (!file || magic != PROGRAM_CACHE_MAGIC || length == 0) {
+        return 0;
+    }
+
+    // the length comes from the file, it has to be what follows the header
+    // before anything is allocated for it
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size (path, error);
+    std::streamoff header = file.tellg ();
+    if (error || header < 0 || size != static_cast<uintmax_t> (header) + length) {
+        std::cout << "cached shader-program is broken, compiling it" << '\n';
+        return 0;
+    }
+
+    std::vector<char> binary (length);
+    if (!file.read (binary.data (), length)) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram ();
+    glProgramBinary (program, format, binary.data (), length);
+
+    GLint linked = 0;
+    glGetProgramiv (program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        std::cout << "cached shader-program rejected, compiling it" << '\n';
+        glDeleteProgram (program);
+        return 0;
+    }
+    return program;
+}
+
+void OpenGL::storeProgramBinary (GLuint program, const std::string& path) const
+{
+    GLint linked = 0;
+    GLint length = 0;
+    glGetProgramiv (program, GL_LINK_STATUS, &linked);
+    glGetProgramiv (program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!linked || length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary (length);
+    GLenum format = 0;
+    glGetProgramBinary (program, length, &length, &format, binary.data ());
+
+    // written aside and renamed, a second instance never reads half a file
+    std::string temporary = path + ".tmp";
+    std::ofstream file (temporary, std::ios::binary);
+    uint32_t magic = PROGRAM_CACHE_MAGIC;
+    uint32_t size = static_cast<uint32_t> (length);
+    file.write (reinterpret_cast<const char*> (&magic), sizeof magic);
+    file.write (reinterpret_cast<const char*> (&format), sizeof format);
+    file.write (reinterpret_cast<const char*> (&size), sizeof size);
+    file.write (binary.data (), length);
+    file.close ();
+
+    std::error_code error;
+    if (file) {
+        std::filesystem::rename (temporary, path, error);
+    } else {
+        std::filesystem::remove (temporary, error);
+    }
 }
 
 GLuint OpenGL::loadShader (const char* src, GLenum type)
@@ -156,26 +499,24 @@ GLuint OpenGL::createShaderProgram (const char* vertSrc,
                                     const char* fragSrc,
                                     bool link)
 {
-    GLuint program = _program;
-
     if (!vertSrc && !fragSrc)
         return 0;
 
     if (vertSrc) {
         _vShaderId = loadShader (vertSrc, GL_VERTEX_SHADER);
         if (!_vShaderId)
-            return _program;
+            return 0;
     }
 
     if (fragSrc) {
         _fShaderId = loadShader (fragSrc, GL_FRAGMENT_SHADER);
         if (!_fShaderId)
-            return _program;
+            return 0;
     }
 
-    program = glCreateProgram ();
+    GLuint program = glCreateProgram ();
     if (!program)
-        return _program;
+        return 0;
 
     if (vertSrc) {
         glAttachShader (program, _vShaderId);
@@ -202,7 +543,7 @@ GLuint OpenGL::createShaderProgram (const char* vertSrc,
         log[sizeof log - 1] = '\0';
         std::cout << "Link failed: " << log << '\n';
         glDeleteProgram (program);
-        return _program;
+        return 0;
     }
 
     return program;
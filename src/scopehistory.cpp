@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <limits>
+
+#include "scopehistory.h"
+
+ScopeHistory::ScopeHistory (size_t frames)
+{
+    _capacity = SCOPE_PYRAMID_FACTOR;
+    while (_capacity < frames) {
+        _capacity *= 2;
+    }
+    _samples.resize (_capacity, .0f);
+
+    // level 0 are the samples themselves
+    _minima.emplace_back ();
+    _maxima.emplace_back ();
+    for (size_t entries = _capacity >> SCOPE_PYRAMID_SHIFT; entries > 0; entries >>= SCOPE_PYRAMID_SHIFT) {
+        _minima.emplace_back (entries, .0f);
+        _maxima.emplace_back (entries, .0f);
+    }
+}
+
+size_t ScopeHistory::capacity () const
+{
+    return _capacity;
+}
+
+void ScopeHistory::append (const float* samples, size_t frames, size_t stride)
+{
+    uint64_t begin = _written;
+    for (size_t i = 0; i < frames; ++i) {
+        _samples[(_written + i) & (_capacity - 1)] = samples[i*stride];
+    }
+    _written += frames;
+    if (_written - begin > _capacity) {
+        begin = _written - _capacity;
+    }
+
+    // every entry the new frames completed, level by level from the bottom
+    for (size_t level = 1; level < _minima.size (); ++level) {
+        size_t shift = level*SCOPE_PYRAMID_SHIFT;
+        size_t mask = (_capacity >> shift) - 1;
+        size_t belowMask = (_capacity >> (shift - SCOPE_PYRAMID_SHIFT)) - 1;
+
+        for (uint64_t entry = begin >> shift; entry < _written >> shift; ++entry) {
+            float minimum = std::numeric_limits<float>::max ();
+            float maximum = std::numeric_limits<float>::lowest ();
+            for (uint64_t below = entry << SCOPE_PYRAMID_SHIFT; below < (entry + 1) << SCOPE_PYRAMID_SHIFT; ++below) {
+                if (level == 1) {
+                    minimum = std::min (minimum, _samples[below & belowMask]);
+                    maximum = std::max (maximum, _samples[below & belowMask]);
+                } else {
+                    minimum = std::min (minimum, _minima[level - 1][below & belowMask]);
+                    maximum = std::max (maximum, _maxima[level - 1][below & belowMask]);
+                }
+            }
+            _minima[level][entry & mask] = minimum;
+            _maxima[level][entry & mask] = maximum;
+        }
+    }
+}
+
+uint64_t ScopeHistory::written () const
+{
+    return _written;
+}
+
+void ScopeHistory::columns (uint64_t end, size_t span, float* out, size_t columns) const
+{
+    int64_t oldest = static_cast<int64_t> (_written > _capacity ? _written - _capacity : 0);
+    int64_t last = static_cast<int64_t> (std::min (end, _written));
+    int64_t start = static_cast<int64_t> (end) - static_cast<int64_t> (span);
+
+    for (size_t column = 0; column < columns; ++column) {
+        int64_t from = start + static_cast<int64_t> (column*span/columns);
+        int64_t to = start + static_cast<int64_t> ((column + 1)*span/columns);
+        // zoomed in further than a frame per column
+        to = std::max (to, from + 1);
+
+        from = std::max (from, oldest);
+        to = std::min (to, last);
+        if (from >= to) {
+            out[2*column] = .0f;
+            out[2*column + 1] = .0f;
+            continue;
+        }
+        minMax (static_cast<uint64_t> (from),
+                static_cast<uint64_t> (to),
+                out[2*column],
+                out[2*column + 1]);
+    }
+}
+
+uint64_t ScopeHistory::trigger (uint64_t end, size_t search) const
+{
+    end = std::min (end, _written);
+    uint64_t oldest = _written > _capacity ? _written - _capacity : 0;
+    if (end > search) {
+        oldest = std::max (oldest, end - search);
+    }
+
+    for (uint64_t frame = end - 1; frame > oldest && frame < end; --frame) {
+        if (_samples[(frame - 1) & (_capacity - 1)] < .0f &&
+            _samples[frame & (_capacity - 1)] >= .0f) {
+            return frame;
+        }
+    }
+    return end;
+}
+
+// Walks from begin to end taking the largest entry starting right there
+// that still fits, the samples themselves only at the ragged edges.
+void ScopeHistory::minMax (uint64_t begin, uint64_t end, float& minimum, float& maximum) const
+{
+    minimum = std::numeric_limits<float>::max ();
+    maximum = std::numeric_limits<float>::lowest ();
+
+    for (uint64_t frame = begin; frame < end;) {
+        size_t level = 0;
+        while (level + 1 < _minima.size ()) {
+            uint64_t size = static_cast<uint64_t> (1) << ((level + 1)*SCOPE_PYRAMID_SHIFT);
+            if ((frame & (size - 1)) != 0 || frame + size > end) {
+                break;
+            }
+            ++level;
+        }
+
+        if (level == 0) {
+            float sample = _samples[frame & (_capacity - 1)];
+            minimum = std::min (minimum, sample);
+            maximum = std::max (maximum, sample);
+            ++frame;
+            continue;
+        }
+
+        size_t shift = level*SCOPE_PYRAMID_SHIFT;
+        size_t entry = static_cast<size_t> (frame >> shift) & ((_capacity >> shift) - 1);
+        minimum = std::min (minimum, _minima[level][entry]);
+        maximum = std::max (maximum, _maxima[level][entry]);
+        frame += static_cast<uint64_t> (1) << shift;
+    }
+}
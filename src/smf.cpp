@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <iostream>
+
+#include "smf.h"
+
+using namespace std;
+
+#define newline '\n'
+
+// tempo in effect until the first tempo-change, 120 bpm
+#define SMF_DEFAULT_TEMPO 500000
+
+static uint32_t bigEndian (const unsigned char* bytes, int count)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < count; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+bool Smf::open (const string& path)
+{
+    _good = false;
+    _tracks.clear ();
+    _tempoTick = 0;
+    _tempoSeconds = .0;
+
+    _file.open (path, ios::binary);
+    if (!_file) {
+        cout << "could not open " << path << newline;
+        return false;
+    }
+
+    unsigned char header[14];
+    if (!_file.read (reinterpret_cast<char*> (header), 14) ||
+        string (reinterpret_cast<char*> (header), 4) != "MThd") {
+        cout << path << " is no Standard MIDI File" << newline;
+        return false;
+    }
+
+    uint32_t length = bigEndian (header + 4, 4);
+    uint32_t format = bigEndian (header + 8, 2);
+    uint32_t tracks = bigEndian (header + 10, 2);
+    _division = static_cast<uint16_t> (bigEndian (header + 12, 2));
+
+    if (length < 6 || format > 1 || (format == 0 && tracks != 1)) {
+        cout << path << ": only SMF type 0 and 1 are supported" << newline;
+        return false;
+    }
+
+    // SMPTE-time has a fixed duration per tick, no tempo-map
+    _smpte = (_division & 0x8000) != 0;
+    if (_smpte) {
+        int framesPerSecond = -static_cast<int8_t> (_division >> 8);
+        double fps = framesPerSecond == 29 ? 29.97 : framesPerSecond;
+        _secondsPerTick = 1./(fps*(_division & 0xff));
+    } else {
+        _secondsPerTick = SMF_DEFAULT_TEMPO*1e-6/_division;
+    }
+
+    // only the chunk-headers are read, the track-data is left for later
+    uint64_t position = 8 + length;
+    while (_tracks.size () < tracks) {
+        unsigned char chunk[8];
+        _file.seekg (position);
+        if (!_file.read (reinterpret_cast<char*> (chunk), 8)) {
+            break;
+        }
+
+        uint32_t size = bigEndian (chunk + 4, 4);
+        if (string (reinterpret_cast<char*> (chunk), 4) == "MTrk") {
+            Track track;
+            track.position = position + 8;
+            track.end = position + 8 + size;
+            track.tick = 0;
+            track.status = 0;
+            track.done = false;
+            track.cursor = 0;
+            track.fill = 0;
+            _tracks.push_back (track);
+        }
+        position += 8 + size;
+    }
+    _file.clear ();
+
+    if (_tracks.size () != tracks) {
+        cout << path << ": " << _tracks.size () << " of " << tracks
+             << " tracks found" << newline;
+    }
+
+    _good = true;
+    for (auto& track : _tracks) {
+        readDelta (track);
+    }
+
+    return !_tracks.empty ();
+}
+
+bool Smf::next (MidiEvent& event)
+{
+    while (true) {
+        // ties go to the lower track, so a tempo-change in the first track
+        // of a type 1 file applies to the notes on the same tick
+        Track* earliest = nullptr;
+        for (auto& track : _tracks) {
+            if (!track.done && (!earliest || track.tick < earliest->tick)) {
+                earliest = &track;
+            }
+        }
+
+        if (!earliest) {
+            return false;
+        }
+
+        bool isNote = false;
+        if (!readEvent (*earliest, event, isNote)) {
+            _good = false;
+            earliest->done = true;
+            continue;
+        }
+
+        event.timeStamp = seconds (earliest->tick);
+        readDelta (*earliest);
+
+        if (isNote) {
+            return true;
+        }
+    }
+}
+
+bool Smf::good () const
+{
+    return _good;
+}
+
+bool Smf::readByte (Track& track, unsigned char& byte)
+{
+    if (track.cursor == track.fill) {
+        if (track.position >= track.end) {
+            return false;
+        }
+
+        uint64_t count = std::min<uint64_t> (SMF_BUFFER, track.end - track.position);
+        _file.seekg (track.position);
+        _file.read (reinterpret_cast<char*> (track.buffer), count);
+        track.fill = static_cast<size_t> (_file.gcount ());
+        track.cursor = 0;
+        track.position += track.fill;
+        _file.clear ();
+
+        if (track.fill == 0) {
+            track.position = track.end;
+            return false;
+        }
+    }
+
+    byte = track.buffer[track.cursor++];
+    return true;
+}
+
+bool Smf::readVariable (Track& track, uint32_t& value)
+{
+    value = 0;
+    unsigned char byte = 0;
+
+    // at most four bytes of seven bits each
+    for (int i = 0; i < 4; ++i) {
+        if (!readByte (track, byte)) {
+            return false;
+        }
+        value = (value << 7) | (byte & 0x7f);
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Smf::skip (Track& track, uint32_t bytes)
+{
+    unsigned char byte = 0;
+    for (uint32_t i = 0; i < bytes; ++i) {
+        if (!readByte (track, byte)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Smf::readDelta (Track& track)
+{
+    uint32_t delta = 0;
+    if (track.done || !readVariable (track, delta)) {
+        track.done = true;
+        return;
+    }
+    track.tick += delta;
+}
+
+bool Smf::readEvent (Track& track, MidiEvent& event, bool& isNote)
+{
+    unsigned char byte = 0;
+    if (!readByte (track, byte)) {
+        return false;
+    }
+
+    if (byte == 0xff) {
+        unsigned char type = 0;
+        uint32_t length = 0;
+        if (!readByte (track, type) || !readVariable (track, length)) {
+            return false;
+        }
+        track.status = 0;
+
+        if (type == 0x2f) {
+            track.done = true;
+            return true;
+        }
+
+        if (type == 0x51 && length == 3 && !_smpte) {
+            unsigned char tempo[3];
+            for (auto& b : tempo) {
+                if (!readByte (track, b)) {
+                    return false;
+                }
+            }
+            _tempoSeconds = seconds (track.tick);
+            _tempoTick = track.tick;
+            _secondsPerTick = bigEndian (tempo, 3)*1e-6/_division;
+            return true;
+        }
+
+        return skip (track, length);
+    }
+
+    if (byte == 0xf0 || byte == 0xf7) {
+        uint32_t length = 0;
+        track.status = 0;
+        return readVariable (track, length) && skip (track, length);
+    }
+
+    unsigned char status = track.status;
+    unsigned char data[2] = {0, 0};
+    int dataBytes = 0;
+
+    // running status: a data-byte repeats the status of the event before
+    if (byte & 0x80) {
+        if (byte > 0xef) {
+            return false;
+        }
+        status = byte;
+        track.status = byte;
+    } else {
+        if (status == 0) {
+            return false;
+        }
+        data[dataBytes++] = byte;
+    }
+
+    int expected = ((status & 0xf0) == 0xc0 || (status & 0xf0) == 0xd0) ? 1 : 2;
+    while (dataBytes < expected) {
+        if (!readByte (track, data[dataBytes++])) {
+            return false;
+        }
+    }
+
+    unsigned char type = status & 0xf0;
+    if (type == 0x90 && data[1] > 0) {
+        event.type = MessageType::NoteOn;
+    } else if (type == 0x80 || type == 0x90) {
+        event.type = MessageType::NoteOff;
+    } else {
+        return true;
+    }
+
+    event.noteId = data[0];
+    event.velocity = data[1];
+    isNote = true;
+    return true;
+}
+
+double Smf::seconds (uint64_t tick) const
+{
+    return _tempoSeconds + (tick - _tempoTick)*_secondsPerTick;
+}
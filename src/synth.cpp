@@ -0,0 +1,768 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+#include "kernels.h"
+#include "synth.h"
+
+using namespace std;
+using namespace std::chrono;
+
+const char* stealPolicyNames[STEAL_POLICIES] = {"oldest",
+                                                "quietest",
+                                                "same-note",
+                                                "release-first"};
+
+// Maps a moment in time onto the audio-stream, is called by the callback
+// before it starts the next block. The frame is placed one block after the
+// block rendered last, counting from when that one was rendered, so events
+// arrive with a constant latency instead of being snapped to a callback.
+// Something that already happened is due within the block about to be
+// rendered at the latest, only time-stamps still ahead may be further out.
+static uint64_t frameAt (const SynthData& synthData,
+                         double timeStamp,
+                         double now,
+                         size_t blockFrames)
+{
+    double offset = (timeStamp - synthData.blockTime)*synthData.sampleRate;
+    if (timeStamp <= now) {
+        offset = std::min (offset, static_cast<double> (blockFrames));
+    }
+    int64_t frame = static_cast<int64_t> (synthData.frames) + llround (offset);
+
+    return static_cast<uint64_t> (std::max<int64_t> (frame, 0));
+}
+
+float keyToPitch (int key, float detune)
+{
+    // using A4 with 440Hz as the base, key = 1 is an A0
+    float fkey = static_cast<float> (key);
+    fkey += detune*.01f;
+    float pitch = pow(2.f, (fkey - 49.f)/12.f)*440.f;
+    return pitch;
+}
+
+float w(float hertz)
+{
+    return 2.f*M_PI*hertz;
+}
+
+float oscSine (float phase,
+               int harmonics,
+               bool even) {
+    float result = .0f;
+
+    forEachPartial (harmonics, even, [&](float harmonic, float amplitude) {
+        // partials are integer multiples of the base-frequency, thus their
+        // phase follows from the base-phase exactly without any own state
+        float partialPhase = phase*harmonic;
+        partialPhase -= floorf (partialPhase);
+        result += amplitude*customSin (partialPhase);
+        return true;
+    });
+
+    return result;
+}
+
+float oscNoise ()
+{
+    return (float) random() / (float) RAND_MAX;
+}
+
+// even oscillators of a note feed the left, odd ones the right channel, each
+// pair is detuned by a multiple of the current detune-amount
+const float detuneSpread[OSCILLATORS_PER_NOTE/2] = {1.f, 1.5f, 3.f, 4.5f};
+
+void fillVoiceBuffer (int instrument,
+                      float* buffer,
+                      size_t frames,
+                      Note& note,
+                      const SynthData& synthData,
+                      float secondPerTick,
+                      float detuneLeft,
+                      float detuneRight,
+                      bool makeDirty)
+{
+    for (int osc = 0; osc < OSCILLATORS_PER_NOTE/2; ++osc) {
+        note.oscillators[2*osc].setFrequency (keyToPitch (note.noteId,
+                                                          detuneLeft*detuneSpread[osc]),
+                                              secondPerTick);
+        note.oscillators[2*osc + 1].setFrequency (keyToPitch (note.noteId,
+                                                              detuneRight*detuneSpread[osc]),
+                                                  secondPerTick);
+    }
+
+    // the band-limited tables only change with the pitch, not per sample
+    const float* squareTables[OSCILLATORS_PER_NOTE];
+    const float* sawtoothTables[OSCILLATORS_PER_NOTE];
+    for (int osc = 0; osc < OSCILLATORS_PER_NOTE; ++osc) {
+        float increment = note.oscillators[osc].increment;
+        squareTables[osc] = synthData.squareTable->select (increment);
+        sawtoothTables[osc] = synthData.sawtoothTable->select (increment);
+    }
+
+    const FmPatch& fmPatch = synthData.fmPatch;
+    const float* sine = synthData.sineTable->select (.0f);
+    fmSetPitch (note.fm[0],
+                fmPatch,
+                keyToPitch (note.noteId, detuneLeft),
+                secondPerTick);
+    fmSetPitch (note.fm[1],
+                fmPatch,
+                keyToPitch (note.noteId, detuneRight),
+                secondPerTick);
+
+    alignas(16) float phases[KERNEL_BLOCK];
+    alignas(16) float left[KERNEL_BLOCK];
+    alignas(16) float right[KERNEL_BLOCK];
+    alignas(16) float gain[KERNEL_BLOCK];
+    alignas(16) float brightness[KERNEL_BLOCK];
+
+    for (size_t offset = 0; offset < frames; offset += KERNEL_BLOCK) {
+        size_t count = std::min<size_t> (KERNEL_BLOCK, frames - offset);
+        note.amplitudeADSR.process (gain, count);
+        kernelScale (gain, note.velocity, count);
+        // kept running for all instruments, so it is in the right stage
+        // whenever the FM-instrument gets selected
+        note.filterADSR.process (brightness, count);
+
+        std::fill_n (left, count, .0f);
+        std::fill_n (right, count, .0f);
+
+        switch (instrument) {
+            case 0 : {
+                for (int osc = 0; osc < OSCILLATORS_PER_NOTE; osc += 2) {
+                    kernelPhases (phases, note.oscillators[osc], count);
+                    kernelSine (left, phases, count);
+                    kernelPhases (phases, note.oscillators[osc + 1], count);
+                    kernelSine (right, phases, count);
+                }
+                break;
+            }
+
+            case 1 : {
+                for (int osc = 0; osc < OSCILLATORS_PER_NOTE; osc += 2) {
+                    kernelPhases (phases, note.oscillators[osc], count);
+                    kernelWavetable (left, squareTables[osc], phases, count);
+                    kernelPhases (phases, note.oscillators[osc + 1], count);
+                    kernelWavetable (right, squareTables[osc + 1], phases, count);
+                }
+                break;
+            }
+
+            case 2 : {
+                for (int osc = 0; osc < OSCILLATORS_PER_NOTE; osc += 2) {
+                    kernelPhases (phases, note.oscillators[osc], count);
+                    kernelWavetable (left, sawtoothTables[osc], phases, count);
+                    kernelPhases (phases, note.oscillators[osc + 1], count);
+                    kernelWavetable (right, sawtoothTables[osc + 1], phases, count);
+                }
+                break;
+            }
+
+            case 3 : {
+                for (int osc = 0; osc < OSCILLATORS_PER_NOTE; osc += 2) {
+                    kernelPhases (phases, note.oscillators[osc], count);
+                    kernelWavetable (left, sawtoothTables[osc], phases, count);
+                    kernelPhases (phases, note.oscillators[osc + 1], count);
+                    kernelWavetable (right, squareTables[osc + 1], phases, count);
+                }
+                break;
+            }
+
+            case 4 : {
+                for (size_t i = 0; i < count; ++i) {
+                    left[i] = oscNoise();
+                    right[i] = oscNoise();
+                }
+                break;
+            }
+
+            case 5 : {
+                // the otherwise unused filter-envelope shapes the timbre
+                for (size_t i = 0; i < count; ++i) {
+                    left[i]  = fmRender (note.fm[0], fmPatch, sine, brightness[i]);
+                    right[i] = fmRender (note.fm[1], fmPatch, sine, brightness[i]);
+                }
+                break;
+            }
+
+            default :
+            break;
+        }
+
+        float* stereo = buffer + 2*offset;
+        kernelInterleaveGain (stereo, left, right, gain, count);
+
+        if (makeDirty) {
+            for (size_t i = 0; i < 2*count; ++i) {
+                stereo[i] += .125*oscNoise();
+            }
+        }
+    }
+}
+
+struct VoiceJobs
+{
+    SynthData* synthData;
+    float secondPerTick;
+    float detuneLeft;
+    float detuneRight;
+    size_t offset;
+    size_t frames;
+};
+
+static void renderVoice (void* context, size_t index)
+{
+    VoiceJobs* voiceJobs = reinterpret_cast<VoiceJobs*> (context);
+    SynthData* synthData = voiceJobs->synthData;
+    Note& note = synthData->synth->activeNote (index);
+    auto start = steady_clock::now ();
+
+    fillVoiceBuffer (synthData->instrument,
+                     synthData->voiceBuffers->at(note.voice).data() + 2*voiceJobs->offset,
+                     voiceJobs->frames,
+                     note,
+                     *synthData,
+                     voiceJobs->secondPerTick,
+                     voiceJobs->detuneLeft,
+                     voiceJobs->detuneRight,
+                     synthData->makeDirty);
+
+    auto end = steady_clock::now ();
+    synthData->monitor->addVoiceTime (note.voice,
+                                      duration<float, std::micro> (end - start).count ());
+}
+
+// Renders all notes at once through the structure-of-arrays voice-bank,
+// each note owns the lanes of its OSCILLATORS_PER_NOTE detuned sines. The
+// lanes follow the notes of the synth: a new note attacks them anew, a
+// stolen note fades them out within the steal-fade and the lanes of a note
+// that is gone are closed.
+static void renderPad (SynthData* synthData,
+                       float* sampleBuffer,
+                       size_t frames,
+                       float detuneLeft,
+                       float detuneRight)
+{
+    VoiceBank& voiceBank = *synthData->voiceBank;
+
+    Synth& synth = *synthData->synth;
+    std::fill (synthData->padSounding.begin (), synthData->padSounding.end (), 0);
+
+    for (size_t index = 0; index < synth.activeNotes (); ++index) {
+        Note* note = &synth.activeNote (index);
+
+        // the bank has envelopes of its own, but the ones of the note decide
+        // about the end of its lifetime
+        note->amplitudeADSR.advance (frames);
+        note->filterADSR.advance (frames);
+
+        bool held = !note->amplitudeADSR.noteReleased;
+        bool fresh = synthData->padNotes[note->voice] != note->started;
+        synthData->padNotes[note->voice] = note->started;
+        synthData->padSounding[note->voice] = 1;
+
+        for (int osc = 0; osc < OSCILLATORS_PER_NOTE; ++osc) {
+            size_t lane = note->voice*OSCILLATORS_PER_NOTE + osc;
+            float detune = (osc % 2 == 0) ? detuneLeft : detuneRight;
+
+            voiceBank.setFrequency (lane, keyToPitch (note->noteId,
+                                                      detune*detuneSpread[osc/2]));
+            if (note->stolen) {
+                voiceBank.fade (lane);
+            } else if (fresh && held) {
+                voiceBank.trigger (lane, note->velocity);
+            } else {
+                voiceBank.gate (lane, held, note->velocity);
+            }
+        }
+    }
+
+    for (size_t voice = 0; voice < synthData->padNotes.size (); ++voice) {
+        if (synthData->padNotes[voice] != 0 && !synthData->padSounding[voice]) {
+            synthData->padNotes[voice] = 0;
+            for (int osc = 0; osc < OSCILLATORS_PER_NOTE; ++osc) {
+                voiceBank.fade (voice*OSCILLATORS_PER_NOTE + osc);
+            }
+        }
+    }
+
+    voiceBank.render (sampleBuffer, frames);
+}
+
+// While another instrument plays, the voice-bank is not rendered, so its
+// envelopes would stand still. Its lanes are silenced instead, a note still
+// held attacks them anew once the pad is back.
+static void stopPad (SynthData* synthData)
+{
+    for (size_t voice = 0; voice < synthData->padNotes.size (); ++voice) {
+        if (synthData->padNotes[voice] != 0) {
+            synthData->padNotes[voice] = 0;
+            for (int osc = 0; osc < OSCILLATORS_PER_NOTE; ++osc) {
+                synthData->voiceBank->stop (voice*OSCILLATORS_PER_NOTE + osc);
+            }
+        }
+    }
+}
+
+// renders the frames following offset of all sounding notes into sampleBuffer
+static void renderSegment (VoiceJobs& voiceJobs,
+                           float* sampleBuffer,
+                           size_t offset,
+                           size_t frames)
+{
+    SynthData* synthData = voiceJobs.synthData;
+    Synth& synth = *synthData->synth;
+    shared_ptr<vector<vector<float>>> voiceBuffers = synthData->voiceBuffers;
+
+    if (synthData->instrument == 6) {
+        renderPad (synthData,
+                   sampleBuffer + 2*offset,
+                   frames,
+                   voiceJobs.detuneLeft,
+                   voiceJobs.detuneRight);
+        return;
+    }
+    stopPad (synthData);
+
+    voiceJobs.offset = offset;
+    voiceJobs.frames = frames;
+    synthData->workerPool->run (renderVoice,
+                                &voiceJobs,
+                                synth.activeNotes ());
+
+    for (size_t index = 0; index < synth.activeNotes (); ++index) {
+        int voice = synth.activeNote (index).voice;
+        kernelAccumulate (sampleBuffer + 2*offset,
+                          (*voiceBuffers)[voice].data() + 2*offset,
+                          2*frames);
+    }
+}
+
+static void applyEvent (Synth& synth, const SynthEvent& event)
+{
+    if (event.type == MessageType::NoteOn) {
+        synth.addNoteMidi (event.noteId, event.velocity);
+    }
+
+    if (event.type == MessageType::NoteOff) {
+        synth.removeNoteMidi (event.noteId, event.velocity);
+    }
+}
+
+// runs on the audio-thread, which owns SynthData and the Synth
+static void applyCommand (SynthData& synthData,
+                          const SynthCommand& command,
+                          double now,
+                          size_t blockFrames)
+{
+    switch (command.type) {
+        case NoteOnCommand :
+        case NoteOffCommand : {
+            // played while the stream stood still, starting it now would
+            // only replay them in a burst. Note-offs still count.
+            if (command.type == NoteOnCommand && command.timeStamp < synthData.resumeTime) {
+                break;
+            }
+
+            SynthEvent event;
+            event.frame = frameAt (synthData, command.timeStamp, now, blockFrames);
+            event.type = command.type == NoteOnCommand ? MessageType::NoteOn
+                                                       : MessageType::NoteOff;
+            event.noteId = command.noteId;
+            event.velocity = command.value;
+
+            // never growing the list on the audio-thread
+            vector<SynthEvent>& events = synthData.events;
+            size_t room = events.capacity () - events.size ();
+            if (event.type == MessageType::NoteOn ? room > NOTE_OFF_RESERVE : room > 0) {
+                events.push_back (event);
+            } else if (event.type == MessageType::NoteOn) {
+                ++synthData.droppedNoteOns;
+            } else {
+                // the note stops now, and nothing still pending can start
+                // it again
+                events.erase (std::remove_if (events.begin (),
+                                              events.end (),
+                                              [&](const SynthEvent& pending) {
+                                                  return pending.noteId == event.noteId;
+                                              }),
+                              events.end ());
+                applyEvent (*synthData.synth, event);
+                ++synthData.earlyNoteOffs;
+            }
+            break;
+        }
+
+        case SetInstrument : synthData.instrument = static_cast<short> (command.value); break;
+        case SetVolume : synthData.volume = command.value; break;
+        case SetDirty : synthData.makeDirty = command.value != .0f; break;
+        case SetFmAlgorithm : synthData.fmPatch.algorithm = static_cast<int> (command.value); break;
+        case SetStealPolicy : synthData.synth->setStealPolicy (static_cast<StealPolicy> (command.value)); break;
+    }
+}
+
+// Insertion-sort, as the events arrive (almost) in order anyway. Unlike
+// std::stable_sort it never allocates and keeps a note-on and note-off for
+// the same frame in the order they were played.
+static void sortEvents (vector<SynthEvent>& events)
+{
+    for (size_t i = 1; i < events.size (); ++i) {
+        SynthEvent event = events[i];
+        size_t j = i;
+        while (j > 0 && events[j - 1].frame > event.frame) {
+            events[j] = events[j - 1];
+            --j;
+        }
+        events[j] = event;
+    }
+}
+
+void renderSynth (SynthData& synthData,
+                  float* sampleBuffer,
+                  size_t frames,
+                  double now)
+{
+    synthData.monitor->beginBlock ();
+
+    // after a pause the last block is long gone, the stream goes on as if
+    // it had been rendered a block ago
+    double blockSeconds = static_cast<double> (frames)/synthData.sampleRate;
+    if (now - synthData.blockTime > STREAM_GAP_BLOCKS*blockSeconds) {
+        synthData.blockTime = now - blockSeconds;
+        synthData.resumeTime = synthData.blockTime;
+    }
+
+    // everything the UI-thread wants changed arrives here, rendering never
+    // takes a lock
+    SynthCommand command;
+    while (synthData.commands && synthData.commands->pop (command)) {
+        applyCommand (synthData, command, now, frames);
+    }
+
+    float secondPerTick = 1.f/static_cast<float> (synthData.sampleRate);
+    float volume = synthData.volume;
+
+    VoiceJobs voiceJobs;
+    voiceJobs.synthData = &synthData;
+    voiceJobs.secondPerTick = secondPerTick;
+    voiceJobs.detuneLeft = 20.f*(.5f + .5f*sin (w (.025f)));
+    voiceJobs.detuneRight = 10.f*(.5f + .5f*sin (w (.025f)));
+
+    size_t samples = 2*frames;
+    uint64_t blockStart = synthData.frames;
+    synthData.blockTime = now;
+
+    // Rendering is split at the frames the pending events are due at, so
+    // notes start and stop on the exact sample. Events which are late are
+    // applied right at the start of the block.
+    vector<SynthEvent>& events = synthData.events;
+    sortEvents (events);
+
+    size_t consumed = 0;
+    size_t position = 0;
+    while (position < frames) {
+        while (consumed < events.size () &&
+               events[consumed].frame <= blockStart + position) {
+            applyEvent (*synthData.synth, events[consumed]);
+            ++consumed;
+        }
+
+        size_t end = frames;
+        if (consumed < events.size () &&
+            events[consumed].frame < blockStart + frames) {
+            end = static_cast<size_t> (events[consumed].frame - blockStart);
+        }
+
+        renderSegment (voiceJobs, sampleBuffer, position, end - position);
+        position = end;
+    }
+
+    events.erase (events.begin (), events.begin () + consumed);
+    synthData.frames += frames;
+    synthData.synth->clearNotes ();
+
+    kernelScale (sampleBuffer, volume, samples);
+
+    // the only work visualisation costs the audio-thread
+    synthData.analyzer->publish (sampleBuffer, frames);
+
+    synthData.monitor->endBlock (static_cast<double> (frames)/synthData.sampleRate);
+}
+
+void setupSynthData (SynthData& synthData,
+                     Synth& synth,
+                     float sampleRate,
+                     size_t channels,
+                     size_t samples,
+                     size_t frequencyBins)
+{
+    // one voice is always rendered by the rendering thread itself
+    size_t workers = std::max (thread::hardware_concurrency (), 1u) - 1;
+
+    synthData.sampleRate = sampleRate;
+    synthData.channels = channels;
+    synthData.samples = samples;
+    synthData.volume = .1f;
+    synthData.instrument = 0;
+    synthData.makeDirty = false;
+    synthData.voiceBuffers = make_shared<vector<vector<float>>> (synth.voices (),
+                                                                 vector<float> (samples*channels, .0f));
+    synthData.workerPool = make_shared<WorkerPool> (workers, synth.voices ());
+    synthData.squareTable = make_shared<Wavetable> (64, false);
+    synthData.sawtoothTable = make_shared<Wavetable> (32, true);
+    synthData.sineTable = make_shared<Wavetable> (1, true);
+    synthData.voiceBank = make_shared<VoiceBank> (synth.voices ()*OSCILLATORS_PER_NOTE,
+                                                  sampleRate);
+    synthData.padNotes.assign (synth.voices (), 0);
+    synthData.padSounding.assign (synth.voices (), 0);
+    synthData.analyzer = make_shared<Analyzer> (samples,
+                                                channels,
+                                                frequencyBins,
+                                                samples,
+                                                sampleRate);
+    synthData.monitor = make_shared<DspMonitor> (synth.voices ());
+    synthData.synth = &synth;
+    synthData.commands = nullptr;
+    synthData.events.clear ();
+    synthData.events.reserve (MAX_PENDING_EVENTS);
+    synthData.frames = 0;
+    synthData.blockTime = .0;
+    synthData.resumeTime = .0;
+}
+
+Synth::Synth (unsigned int maxVoices, float sampleRate)
+    : _voices (maxVoices + STEAL_FADE_VOICES)
+    , _voiceOfNote (MAX_NOTE_IDS, -1)
+    , _maxVoices {maxVoices}
+    , _sampleRate {sampleRate}
+{
+    _active.reserve (_voices.size ());
+    _freeVoices.reserve (_voices.size ());
+
+    // handed out from the back, so voice 0 goes first
+    for (int voice = _voices.size () - 1; voice >= 0; --voice) {
+        _freeVoices.push_back (voice);
+    }
+}
+
+void Synth::setStealPolicy (StealPolicy policy)
+{
+    _stealPolicy = policy;
+}
+
+StealPolicy Synth::stealPolicy () const
+{
+    return _stealPolicy;
+}
+
+size_t Synth::voices () const
+{
+    return _voices.size ();
+}
+
+unsigned long Synth::steals () const
+{
+    return _steals.load (std::memory_order_relaxed);
+}
+
+unsigned long Synth::retriggers () const
+{
+    return _retriggers.load (std::memory_order_relaxed);
+}
+
+unsigned long Synth::hardCuts () const
+{
+    return _hardCuts.load (std::memory_order_relaxed);
+}
+
+void Synth::addNoteMidi(NoteId noteId, float velocity)
+{
+    Note* note = findNote (noteId);
+
+    if (note) {
+        bool held = !note->amplitudeADSR.noteReleased;
+        if (!held || _stealPolicy == StealSameNote) {
+            note->amplitudeADSR.noteOn ();
+            note->filterADSR.noteOn ();
+            note->velocity = velocity;
+            note->started = ++_noteCounter;
+            if (held) {
+                _retriggers.fetch_add (1, std::memory_order_relaxed);
+            }
+        }
+        return;
+    }
+
+    if (noteId + NOTE_ID_OFFSET < 0 || noteId + NOTE_ID_OFFSET >= MAX_NOTE_IDS) {
+        return;
+    }
+
+    if (_sounding >= _maxVoices) {
+        int victim = chooseVictim ();
+        if (victim < 0) {
+            return;
+        }
+        fadeOut (_voices[victim]);
+        _steals.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    int voice = allocVoice();
+    if (voice < 0) {
+        // more steals within one block than spare voices, so one of the
+        // fading notes has to go without finishing its fade
+        voice = reclaimFading ();
+        _hardCuts.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    // a fresh Note in place, the slot of the voice is reused as it is
+    Note& slot = _voices[voice];
+    slot = Note ();
+    slot.noteId = noteId;
+    slot.voice = voice;
+    slot.velocity = velocity;
+    slot.started = ++_noteCounter;
+    slot.amplitudeADSR.sampleRate = _sampleRate;
+    slot.filterADSR.sampleRate = _sampleRate;
+    slot.filterADSR.attackTime = .5f;
+    slot.filterADSR.decayTime = .1f;
+    slot.filterADSR.sustainLevel = .7f;
+    slot.filterADSR.releaseTime = 1.f;
+    slot.amplitudeADSR.noteOn ();
+    slot.filterADSR.noteOn ();
+
+    _voiceOfNote[noteId + NOTE_ID_OFFSET] = voice;
+    _active.push_back (voice);
+    ++_sounding;
+}
+
+void Synth::removeNoteMidi(NoteId noteId, float velocity)
+{
+    Note* note = findNote (noteId);
+
+    if (note) {
+        note->amplitudeADSR.noteOff ();
+        note->filterADSR.noteOff ();
+    }
+}
+
+void Synth::clearNotes ()
+{
+    // swap-remove keeps the sounding voices densely packed
+    for (size_t index = _active.size (); index-- > 0;) {
+        Note& note = _voices[_active[index]];
+        if (note.amplitudeADSR.noteActive) {
+            continue;
+        }
+
+        // a stolen note already left the index and the count when stolen
+        if (!note.stolen) {
+            _voiceOfNote[note.noteId + NOTE_ID_OFFSET] = -1;
+            --_sounding;
+        }
+        freeVoice (note.voice);
+
+        _active[index] = _active.back ();
+        _active.pop_back ();
+    }
+}
+
+size_t Synth::activeNotes () const
+{
+    return _active.size ();
+}
+
+Note& Synth::activeNote (size_t index)
+{
+    return _voices[_active[index]];
+}
+
+Note* Synth::findNote (NoteId noteId)
+{
+    if (noteId + NOTE_ID_OFFSET < 0 || noteId + NOTE_ID_OFFSET >= MAX_NOTE_IDS) {
+        return nullptr;
+    }
+
+    int voice = _voiceOfNote[noteId + NOTE_ID_OFFSET];
+    return voice < 0 ? nullptr : &_voices[voice];
+}
+
+int Synth::allocVoice()
+{
+    if (_freeVoices.empty ()) {
+        return -1;
+    }
+
+    int voice = _freeVoices.back ();
+    _freeVoices.pop_back ();
+    return voice;
+}
+
+void Synth::freeVoice(int voice)
+{
+    _freeVoices.push_back (voice);
+}
+
+int Synth::chooseVictim () const
+{
+    int oldest = -1;
+    int quietest = -1;
+    int quietestReleased = -1;
+
+    for (int voice : _active) {
+        const Note& note = _voices[voice];
+        if (note.stolen) {
+            continue;
+        }
+
+        if (oldest < 0 || note.started < _voices[oldest].started) {
+            oldest = voice;
+        }
+        if (quietest < 0 || note.amplitudeADSR.level () < _voices[quietest].amplitudeADSR.level ()) {
+            quietest = voice;
+        }
+        if (note.amplitudeADSR.noteReleased
+            && (quietestReleased < 0
+                || note.amplitudeADSR.level () < _voices[quietestReleased].amplitudeADSR.level ())) {
+            quietestReleased = voice;
+        }
+    }
+
+    switch (_stealPolicy) {
+        case StealQuietest : return quietest;
+        case StealReleaseFirst : return quietestReleased >= 0 ? quietestReleased : oldest;
+        default : return oldest;
+    }
+}
+
+void Synth::fadeOut (Note& note)
+{
+    _voiceOfNote[note.noteId + NOTE_ID_OFFSET] = -1;
+    --_sounding;
+
+    note.stolen = true;
+    note.amplitudeADSR.releaseTime = STEAL_FADE_TIME;
+    note.amplitudeADSR.noteOff ();
+    note.filterADSR.noteOff ();
+}
+
+int Synth::reclaimFading ()
+{
+    size_t quietest = 0;
+    for (size_t index = 1; index < _active.size (); ++index) {
+        const Note& note = _voices[_active[index]];
+        if (note.stolen
+            && (!_voices[_active[quietest]].stolen
+                || note.amplitudeADSR.level () < _voices[_active[quietest]].amplitudeADSR.level ())) {
+            quietest = index;
+        }
+    }
+
+    int voice = _active[quietest];
+    _active[quietest] = _active.back ();
+    _active.pop_back ();
+    return voice;
+}
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cmath>
+
+#include "kernels.h"
+#include "voicebank.h"
+
+#if defined(__SSE2__) && !defined(KERNELS_FORCE_SCALAR)
+#include <emmintrin.h>
+#define VOICEBANK_SSE2
+#endif
+
+#define LANE(array, lane) (array[(lane)/VOICEBANK_GROUP].lane[(lane)%VOICEBANK_GROUP])
+
+VoiceBank::VoiceBank (size_t lanes, float sampleRate)
+    : _secondPerTick {1.f/sampleRate}
+{
+    size_t groups = (lanes + VOICEBANK_GROUP - 1)/VOICEBANK_GROUP;
+    Group zero = {};
+
+    _increment.assign (groups, zero);
+    _phase.assign (groups, zero);
+    _level.assign (groups, zero);
+    _step.assign (groups, zero);
+    _peak.assign (groups, zero);
+    _stage.assign (groups*VOICEBANK_GROUP, Idle);
+    _activeLanes.assign (groups, 0);
+}
+
+void VoiceBank::setFrequency (size_t lane, float frequency)
+{
+    float increment = frequency*_secondPerTick;
+    LANE(_increment, lane) = increment - floorf (increment);
+}
+
+void VoiceBank::gate (size_t lane, bool open, float velocity)
+{
+    int& stage = _stage[lane];
+
+    if (open && (stage == Idle || stage == Release || stage == Fade)) {
+        trigger (lane, velocity);
+    } else if (!open && stage != Idle && stage != Release && stage != Fade) {
+        stage = Release;
+    }
+}
+
+void VoiceBank::trigger (size_t lane, float velocity)
+{
+    int& stage = _stage[lane];
+
+    if (stage == Idle) {
+        ++_activeLanes[lane/VOICEBANK_GROUP];
+    }
+    stage = Attack;
+    LANE(_peak, lane) = velocity;
+}
+
+void VoiceBank::fade (size_t lane)
+{
+    int& stage = _stage[lane];
+
+    if (stage != Idle) {
+        stage = Fade;
+    }
+}
+
+void VoiceBank::stop (size_t lane)
+{
+    int& stage = _stage[lane];
+
+    if (stage != Idle) {
+        --_activeLanes[lane/VOICEBANK_GROUP];
+        stage = Idle;
+    }
+    LANE(_level, lane) = .0f;
+    LANE(_step, lane) = .0f;
+}
+
+bool VoiceBank::active (size_t lane) const
+{
+    return _stage[lane] != Idle;
+}
+
+bool VoiceBank::sounding () const
+{
+    for (int lanes : _activeLanes) {
+        if (lanes > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+float VoiceBank::level (size_t lane) const
+{
+    return LANE(_level, lane);
+}
+
+void VoiceBank::advanceEnvelopes (size_t group, size_t frames)
+{
+    float duration = static_cast<float> (frames)*_secondPerTick;
+
+    for (int index = 0; index < VOICEBANK_GROUP; ++index) {
+        int& stage = _stage[group*VOICEBANK_GROUP + index];
+        float level = _level[group].lane[index];
+        float peak = _peak[group].lane[index];
+        float sustain = sustainLevel*peak;
+        float target = .0f;
+
+        switch (stage) {
+            case Attack :
+                target = level + duration*peak/attackTime;
+                if (target >= peak) {
+                    target = peak;
+                    stage = Decay;
+                }
+            break;
+
+            case Decay :
+                target = level - duration*(peak - sustain)/decayTime;
+                if (target <= sustain) {
+                    target = sustain;
+                    stage = Sustain;
+                }
+            break;
+
+            case Sustain :
+                target = sustain;
+            break;
+
+            // at the rate it would fall from sustain, or from the peak if
+            // that is silent. A lane triggered without a peak never had a
+            // level to lose and is done at once.
+            case Release :
+                target = level - duration*(sustain > .0f ? sustain : peak)/releaseTime;
+                if (target <= .0f || peak <= .0f) {
+                    target = .0f;
+                    stage = Idle;
+                    --_activeLanes[group];
+                }
+            break;
+
+            case Fade :
+                target = level - duration*std::max (peak, level)/fadeTime;
+                if (target <= .0f) {
+                    target = .0f;
+                    stage = Idle;
+                    --_activeLanes[group];
+                }
+            break;
+
+            default :
+            break;
+        }
+
+        _step[group].lane[index] = (target - level)/static_cast<float> (frames);
+    }
+}
+
+void VoiceBank::render (float* out, size_t frames)
+{
+    for (size_t start = 0; start < frames; start += KERNEL_BLOCK) {
+        size_t count = std::min<size_t> (KERNEL_BLOCK, frames - start);
+        float* stereo = out + 2*start;
+
+#if defined(VOICEBANK_SSE2)
+        // one (left, right, left, right) accumulator per frame, folded into
+        // the stereo output once all groups are done
+        __m128 sums[KERNEL_BLOCK];
+        std::fill_n (sums, count, _mm_setzero_ps ());
+
+        __m128 scale = _mm_set1_ps (20.785f);
+        __m128 linear = _mm_set1_ps (1.5f);
+        __m128 constant = _mm_set1_ps (.5f);
+
+        for (size_t group = 0; group < _phase.size (); ++group) {
+            if (_activeLanes[group] == 0) {
+                continue;
+            }
+
+            advanceEnvelopes (group, count);
+
+            __m128 phase0 = _mm_load_ps (_phase[group].lane);
+            __m128 phase1 = _mm_load_ps (_phase[group].lane + 4);
+            __m128 increment0 = _mm_load_ps (_increment[group].lane);
+            __m128 increment1 = _mm_load_ps (_increment[group].lane + 4);
+            __m128 level0 = _mm_load_ps (_level[group].lane);
+            __m128 level1 = _mm_load_ps (_level[group].lane + 4);
+            __m128 step0 = _mm_load_ps (_step[group].lane);
+            __m128 step1 = _mm_load_ps (_step[group].lane + 4);
+
+            for (size_t i = 0; i < count; ++i) {
+                __m128 poly0 = _mm_add_ps (_mm_sub_ps (_mm_mul_ps (phase0, phase0),
+                                                       _mm_mul_ps (linear, phase0)),
+                                           constant);
+                __m128 poly1 = _mm_add_ps (_mm_sub_ps (_mm_mul_ps (phase1, phase1),
+                                                       _mm_mul_ps (linear, phase1)),
+                                           constant);
+                __m128 sine0 = _mm_mul_ps (_mm_mul_ps (scale, phase0), poly0);
+                __m128 sine1 = _mm_mul_ps (_mm_mul_ps (scale, phase1), poly1);
+
+                sums[i] = _mm_add_ps (sums[i],
+                                      _mm_add_ps (_mm_mul_ps (sine0, level0),
+                                                  _mm_mul_ps (sine1, level1)));
+
+                phase0 = _mm_add_ps (phase0, increment0);
+                phase1 = _mm_add_ps (phase1, increment1);
+                phase0 = _mm_sub_ps (phase0, _mm_cvtepi32_ps (_mm_cvttps_epi32 (phase0)));
+                phase1 = _mm_sub_ps (phase1, _mm_cvtepi32_ps (_mm_cvttps_epi32 (phase1)));
+                level0 = _mm_add_ps (level0, step0);
+                level1 = _mm_add_ps (level1, step1);
+            }
+
+            _mm_store_ps (_phase[group].lane, phase0);
+            _mm_store_ps (_phase[group].lane + 4, phase1);
+            _mm_store_ps (_level[group].lane, level0);
+            _mm_store_ps (_level[group].lane + 4, level1);
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            alignas(16) float sum[4];
+            _mm_store_ps (sum, sums[i]);
+            stereo[2*i] += sum[0] + sum[2];
+            stereo[2*i + 1] += sum[1] + sum[3];
+        }
+#else
+        for (size_t group = 0; group < _phase.size (); ++group) {
+            if (_activeLanes[group] == 0) {
+                continue;
+            }
+
+            advanceEnvelopes (group, count);
+
+            Group& phase = _phase[group];
+            Group& level = _level[group];
+            const Group& increment = _increment[group];
+            const Group& step = _step[group];
+
+            for (size_t i = 0; i < count; ++i) {
+                for (int lane = 0; lane < VOICEBANK_GROUP; ++lane) {
+                    stereo[2*i + lane%2] += customSin (phase.lane[lane])*level.lane[lane];
+                    phase.lane[lane] += increment.lane[lane];
+                    phase.lane[lane] -= static_cast<float> (static_cast<int> (phase.lane[lane]));
+                    level.lane[lane] += step.lane[lane];
+                }
+            }
+        }
+#endif
+
+        // rounding must not leave finished lanes ever so slightly audible
+        for (size_t group = 0; group < _phase.size (); ++group) {
+            for (int lane = 0; lane < VOICEBANK_GROUP; ++lane) {
+                int stage = _stage[group*VOICEBANK_GROUP + lane];
+                if (stage == Idle) {
+                    _level[group].lane[lane] = .0f;
+                }
+            }
+        }
+    }
+}
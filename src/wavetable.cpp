@@ -0,0 +1,46 @@
+#include <cmath>
+
+#include "oscillator.h"
+#include "wavetable.h"
+
+// highest increment (cycles per sample) the lowest octave-table is used for,
+// each following table covers twice that up to Nyquist in the topmost one
+#define TOP_INCREMENT (.5f/static_cast<float> (1 << (WAVETABLE_OCTAVES - 1)))
+
+Wavetable::Wavetable (int harmonics, bool even)
+    : _tables (WAVETABLE_OCTAVES*(WAVETABLE_SIZE + 1), .0f)
+{
+    for (int octave = 0; octave < WAVETABLE_OCTAVES; ++octave) {
+        float* table = &_tables[octave*(WAVETABLE_SIZE + 1)];
+        float topIncrement = TOP_INCREMENT*static_cast<float> (1 << octave);
+
+        // each partial as an exact sine, the tables are computed once and a
+        // polynomial's own overtones would undo the band-limit
+        forEachPartial (harmonics, even, [&](float harmonic, float amplitude) {
+            // keep the overtones below Nyquist for the highest pitch
+            if (harmonic > 1.f && harmonic*topIncrement >= .5f) {
+                return false;
+            }
+
+            for (int sample = 0; sample < WAVETABLE_SIZE; ++sample) {
+                double phase = static_cast<double> (sample)/WAVETABLE_SIZE;
+                table[sample] += amplitude*sin (2.*M_PI*harmonic*phase);
+            }
+            return true;
+        });
+
+        table[WAVETABLE_SIZE] = table[0];
+    }
+}
+
+const float* Wavetable::select (float increment) const
+{
+    int octave = 0;
+    float topIncrement = TOP_INCREMENT;
+    while (octave < WAVETABLE_OCTAVES - 1 && increment > topIncrement) {
+        topIncrement *= 2.f;
+        ++octave;
+    }
+
+    return &_tables[octave*(WAVETABLE_SIZE + 1)];
+}
@@ -0,0 +1,154 @@
+#include <chrono>
+
+#include "workerpool.h"
+
+using namespace std::chrono;
+
+// number of polls of the completion-counter before the dispatching thread
+// starts yielding between them
+#define SPIN_LIMIT 4096
+// how long an idle worker sleeps before it looks for a batch on its own, in
+// case it missed the wake-up
+#define WORKER_SLEEP_MICROSECONDS 500
+
+WorkerPool::WorkerPool (size_t workers, size_t maxJobs)
+    : _jobMicroseconds (maxJobs, .0f)
+{
+    _threads.reserve (workers);
+    for (size_t i = 0; i < workers; ++i) {
+        _threads.push_back (std::thread (&WorkerPool::work, this));
+    }
+}
+
+WorkerPool::~WorkerPool ()
+{
+    {
+        std::lock_guard<std::mutex> guard (_mutex);
+        _running.store (false, std::memory_order_release);
+    }
+    _wake.notify_all ();
+
+    for (auto& thread : _threads) {
+        thread.join ();
+    }
+}
+
+void WorkerPool::run (Job job, void* context, size_t count)
+{
+    auto start = steady_clock::now ();
+
+    if (count == 0) {
+        _runMicroseconds = .0f;
+        return;
+    }
+
+    // all jobs of the previous batch are done, so no worker claims one with
+    // these before the ticket below announces them
+    uint32_t generation = ++_generation;
+    _job.store (job, std::memory_order_relaxed);
+    _context.store (context, std::memory_order_relaxed);
+    _count.store (count, std::memory_order_relaxed);
+    _pending.store (count, std::memory_order_relaxed);
+    _ticket.store (static_cast<uint64_t> (generation) << 32,
+                   std::memory_order_release);
+
+    // With the mutex, a worker is either asleep already or sees the new
+    // ticket before it goes to sleep. Without it a worker may miss this
+    // batch, which costs parallelism but never correctness.
+    if (_mutex.try_lock ()) {
+        _mutex.unlock ();
+    }
+    _wake.notify_all ();
+
+    // the dispatching thread takes its share of the work too
+    execute (generation, job, context, count);
+
+    for (int spin = 0; _pending.load (std::memory_order_acquire) != 0; ++spin) {
+        if (spin >= SPIN_LIMIT) {
+            std::this_thread::yield ();
+        }
+    }
+
+    auto end = steady_clock::now ();
+    _runMicroseconds = duration<float, std::micro> (end - start).count ();
+}
+
+size_t WorkerPool::workers () const
+{
+    return _threads.size ();
+}
+
+float WorkerPool::jobMicroseconds (size_t index) const
+{
+    return index < _jobMicroseconds.size () ? _jobMicroseconds[index] : .0f;
+}
+
+float WorkerPool::runMicroseconds () const
+{
+    return _runMicroseconds;
+}
+
+void WorkerPool::work ()
+{
+    uint32_t seen = 0;
+
+    while (_running.load (std::memory_order_acquire)) {
+        uint64_t ticket = _ticket.load (std::memory_order_acquire);
+        uint32_t generation = static_cast<uint32_t> (ticket >> 32);
+
+        if (generation == seen) {
+            std::unique_lock<std::mutex> lock (_mutex);
+            _wake.wait_for (lock, microseconds (WORKER_SLEEP_MICROSECONDS), [this, seen] {
+                return !_running.load (std::memory_order_acquire) ||
+                       static_cast<uint32_t> (_ticket.load (std::memory_order_acquire) >> 32) != seen;
+            });
+            continue;
+        }
+
+        seen = generation;
+        execute (generation,
+                 _job.load (std::memory_order_relaxed),
+                 _context.load (std::memory_order_relaxed),
+                 _count.load (std::memory_order_relaxed));
+    }
+}
+
+void WorkerPool::execute (uint32_t generation,
+                          Job job,
+                          void* context,
+                          size_t count)
+{
+    // Jobs are claimed with a compare-and-swap on a ticket tagged with the
+    // generation, so a worker waking up late can never steal an index of a
+    // newer batch and run it with a stale job/context.
+    uint64_t ticket = _ticket.load (std::memory_order_acquire);
+
+    while (true) {
+        if (static_cast<uint32_t> (ticket >> 32) != generation) {
+            return;
+        }
+
+        size_t index = static_cast<size_t> (ticket & 0xffffffff);
+        if (index >= count) {
+            return;
+        }
+
+        if (!_ticket.compare_exchange_weak (ticket,
+                                            ticket + 1,
+                                            std::memory_order_acq_rel)) {
+            continue;
+        }
+
+        auto start = steady_clock::now ();
+        job (context, index);
+        auto end = steady_clock::now ();
+
+        if (index < _jobMicroseconds.size ()) {
+            _jobMicroseconds[index] = duration<float, std::micro> (end - start).count ();
+        }
+
+        _pending.fetch_sub (1, std::memory_order_release);
+
+        ticket = _ticket.load (std::memory_order_acquire);
+    }
+}